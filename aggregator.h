@@ -0,0 +1,140 @@
+/*
+ * File:   aggregator.h
+ */
+
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <vector>
+#include <thread>
+#include "arraymap.h"
+
+namespace ljl {
+
+/**
+ * Aggregates values (e.g. counts) from several threads without
+ * sharing a map between them. Every thread updates its own local
+ * array_map; afterwards the locals are merged with a combiner, either
+ * at once or in disjoint hash partitions by several threads.
+ *
+ * Example:
+ *     aggregator<std::string, long> counts(threads);
+ *     // on thread t
+ *     counts.local(t)[word] += 1;
+ *     // after joining
+ *     auto total = counts.merge([](long& a, long b) { a += b; });
+ */
+template<typename K, typename V>
+class aggregator {
+public:
+    using size_type = size_t;
+    using map_type = array_map<K, V>;
+
+    /**
+     * @param threads - number of local maps to create
+     */
+    explicit aggregator(size_type threads) : _locals(threads) {}
+
+    /**
+     * Returns the local map of a thread. Each local map must only be
+     * used by one thread at a time.
+     *
+     * @param thread - index of the thread, less than threads()
+     * @return The local map of thread.
+     */
+    map_type& local(size_type thread) {
+        return _locals[thread].map;
+    }
+    const map_type& local(size_type thread) const {
+        return _locals[thread].map;
+    }
+
+    /**
+     * @return The number of local maps.
+     */
+    size_type threads() const {
+        return _locals.size();
+    }
+
+    /**
+     * Merges partition part of parts of every local map into target.
+     * Different partitions may be merged concurrently into different
+     * targets, as long as no thread updates the local maps meanwhile.
+     *
+     * @param target - container to merge into
+     * @param combiner - callable as combiner(V&, const V&)
+     * @param part - partition to merge, less than parts
+     * @param parts - number of partitions
+     */
+    template<typename Combiner>
+    void merge_partition(map_type& target, Combiner combiner,
+            size_type part, size_type parts) const
+    {
+        for(const padded_map& local : _locals)
+            local.map.merge_into(target, combiner, part, parts);
+    }
+
+    /**
+     * Merges the local maps into parts disjoint partitions, one thread
+     * per partition. Every local map is first split into partitions in
+     * a single pass (one thread per local map), so the total work does
+     * not grow with the number of partitions.
+     *
+     * @param combiner - callable as combiner(V&, const V&)
+     * @param parts - number of partitions and merging threads
+     * @return The merged partitions, a key is in exactly one of them.
+     */
+    template<typename Combiner>
+    std::vector<map_type> merge_parallel(Combiner combiner, size_type parts) const {
+        std::vector<std::vector<std::vector<size_type>>> slots(_locals.size());
+        run_parallel(_locals.size(), [&](size_type t) {
+            slots[t] = _locals[t].map.partition_slots(parts);
+        });
+
+        std::vector<map_type> results(parts);
+        run_parallel(parts, [&](size_type p) {
+            for(size_type t = 0; t < _locals.size(); t++)
+                _locals[t].map.merge_slots(results[p], combiner, slots[t][p]);
+        });
+        return results;
+    }
+
+    /**
+     * Merges all local maps into one.
+     *
+     * @param combiner - callable as combiner(V&, const V&)
+     * @return The merged map.
+     */
+    template<typename Combiner>
+    map_type merge(Combiner combiner) const {
+        map_type result;
+        merge_partition(result, combiner, 0, 1);
+        return result;
+    }
+
+private:
+    // Keeps the size counters of neighbouring maps off a shared cache line.
+    struct padded_map {
+        map_type map;
+        char padding[64];
+    };
+
+    std::vector<padded_map> _locals;
+
+    // Calls task(i) for every i < count, each on its own thread.
+    template<typename Task>
+    static void run_parallel(size_type count, Task task) {
+        std::vector<std::thread> workers;
+        for(size_type i = 1; i < count; i++)
+            workers.emplace_back(task, i);
+        if(count > 0)
+            task(0);
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+};
+
+}
+
+#endif /* AGGREGATOR_H */
+
@@ -0,0 +1,244 @@
+/*
+ * File:   allocation.h
+ */
+
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <cstddef>
+#include <new>
+
+#include <atomic>
+#include <algorithm>
+
+#ifdef __linux__
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ljl {
+
+enum class page_size {
+    normal,
+    huge_2mb,
+    huge_1gb
+};
+
+enum class numa_placement {
+    none,       // kernel default, pages land on the node that touches them first
+    interleave, // pages are spread round-robin over all nodes
+    node        // pages are preferably placed on allocation_policy::node
+};
+
+/**
+ * Describes how the slot array of a container is allocated. The
+ * default policy allocates from the heap like new[] does. Huge pages
+ * and NUMA placement are only available on Linux and fall back to
+ * normal pages when the system can not provide them.
+ */
+struct allocation_policy {
+    allocation_policy(
+            page_size pages = page_size::normal,
+            numa_placement numa = numa_placement::none,
+            int node = 0,
+            bool prefault = false)
+        : pages(pages), numa(numa), node(node), prefault(prefault) {}
+
+    page_size pages;
+    numa_placement numa;
+    int node;
+    // Fault in every page on allocation instead of on first use.
+    bool prefault;
+};
+
+struct allocation {
+    void* data;
+    size_t length;
+    bool mapped;
+};
+
+namespace detail {
+
+#ifdef __linux__
+const int MPOL_PREFERRED_MODE = 1;
+const int MPOL_INTERLEAVE_MODE = 3;
+const int HUGE_SHIFT = 26; // MAP_HUGE_SHIFT
+
+inline size_t round_up(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+const int MAX_NODES = 1024;
+
+/*
+ * Reads the online NUMA nodes (e.g. "0-3,5") into mask and returns the
+ * highest one, or -1 if the list can not be read.
+ */
+inline int online_nodes(unsigned long (&mask)[MAX_NODES / 64]) {
+    std::ifstream file("/sys/devices/system/node/online");
+    int highest = -1;
+    int first;
+    while(file >> first) {
+        int last = first;
+        if(file.peek() == '-') {
+            file.get();
+            file >> last;
+        }
+        for(int node = first; node <= last && node >= 0 && node < MAX_NODES; node++) {
+            mask[node / 64] |= 1UL << (node % 64);
+            highest = std::max(highest, node);
+        }
+        if(file.peek() == ',')
+            file.get();
+    }
+    return highest;
+}
+
+inline std::atomic<size_t>& placement_failure_count() {
+    static std::atomic<size_t> failures(0);
+    return failures;
+}
+
+inline void place_pages(void* data, size_t length, const allocation_policy& policy) {
+    if(policy.numa == numa_placement::none)
+        return;
+
+    unsigned long online[MAX_NODES / 64] = {};
+    int highest = online_nodes(online);
+    unsigned long nodes[MAX_NODES / 64] = {};
+    int mode = MPOL_INTERLEAVE_MODE;
+    if(policy.numa == numa_placement::interleave) {
+        std::copy(online, online + MAX_NODES / 64, nodes);
+    } else {
+        mode = MPOL_PREFERRED_MODE;
+        if(policy.node >= 0 && policy.node <= highest)
+            nodes[policy.node / 64] = online[policy.node / 64] & (1UL << (policy.node % 64));
+    }
+    // Only pass as many bits as there are nodes, kernels reject set bits 
+    // beyond their own node limit.
+    bool any = std::any_of(nodes, nodes + MAX_NODES / 64, 
+            [](unsigned long mask) { return mask != 0; });
+    if(!any || syscall(SYS_mbind, data, length, mode, nodes, highest + 2, 0) != 0)
+        placement_failure_count()++;
+}
+
+inline void* map_pages(size_t length, int flags) {
+    void* data = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return data == MAP_FAILED ? nullptr : data;
+}
+#endif
+
+}
+
+/**
+ * Returns how many allocations asked for NUMA placement that the system
+ * refused, e.g. because it has no NUMA support or the node is offline.
+ * Such allocations keep the kernel's default placement.
+ *
+ * @return Number of failed placements since the program started.
+ */
+inline size_t numa_placement_failures() {
+#ifdef __linux__
+    return detail::placement_failure_count().load();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Allocates bytes of uninitialized memory according to policy.
+ *
+ * @param bytes - number of bytes to allocate
+ * @param policy - page size and placement to use
+ * @return The allocation, which must be released with release_pages.
+ */
+inline allocation allocate_pages(size_t bytes, const allocation_policy& policy) {
+#ifdef __linux__
+    bool special = policy.pages != page_size::normal 
+            || policy.numa != numa_placement::none || policy.prefault;
+    if(special && bytes > 0) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t huge = policy.pages == page_size::huge_1gb ? 1UL << 30 : 1UL << 21;
+        int shift = policy.pages == page_size::huge_1gb ? 30 : 21;
+        // Prefaulting must wait for mbind, otherwise the pages are placed already.
+        int populate = policy.prefault && policy.numa == numa_placement::none
+                ? MAP_POPULATE : 0;
+
+        allocation block = {nullptr, 0, true};
+        bool populated = populate != 0;
+        if(policy.pages != page_size::normal && bytes >= huge) {
+            block.length = detail::round_up(bytes, huge);
+            block.data = detail::map_pages(block.length,
+                    MAP_HUGETLB | (shift << detail::HUGE_SHIFT) | populate);
+            if(block.data == nullptr) {
+                // No reserved huge pages, ask for transparent huge pages instead.
+                block.data = detail::map_pages(block.length, 0);
+                if(block.data != nullptr)
+                    madvise(block.data, block.length, MADV_HUGEPAGE);
+                populated = false;
+            }
+        } else {
+            block.length = detail::round_up(bytes, page);
+            block.data = detail::map_pages(block.length, populate);
+        }
+        if(block.data == nullptr)
+            throw std::bad_alloc();
+
+        detail::place_pages(block.data, block.length, policy);
+        if(policy.prefault && !populated) {
+            volatile char* touch = static_cast<char*>(block.data);
+            for(size_t i = 0; i < block.length; i += page)
+                touch[i] = 0;
+        }
+        return block;
+    }
+#endif
+    allocation block = {::operator new(bytes), bytes, false};
+    return block;
+}
+
+/**
+ * Releases memory obtained from allocate_pages.
+ *
+ * @param block - the allocation to release
+ */
+inline void release_pages(const allocation& block) {
+    if(block.data == nullptr)
+        return;
+#ifdef __linux__
+    if(block.mapped) {
+        munmap(block.data, block.length);
+        return;
+    }
+#endif
+    ::operator delete(block.data);
+}
+
+/**
+ * Returns the memory of the whole pages within [data, data + bytes) to
+ * the system while keeping the range allocated. The range must not be
+ * read again before it is written.
+ *
+ * @param data - start of the range
+ * @param bytes - length of the range
+ */
+inline void discard_pages(void* data, size_t bytes) {
+#ifdef __linux__
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t first = detail::round_up(reinterpret_cast<size_t>(data), page);
+    size_t last = (reinterpret_cast<size_t>(data) + bytes) / page * page;
+    if(first < last)
+        madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+#else
+    (void)data;
+    (void)bytes;
+#endif
+}
+
+}
+
+#endif /* ALLOCATION_H */
+
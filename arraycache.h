@@ -0,0 +1,337 @@
+/*
+ * File:   arraycache.h
+ */
+
+#ifndef ARRAYCACHE_H
+#define ARRAYCACHE_H
+
+#include <utility>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include "container.h"
+
+namespace ljl {
+
+namespace detail {
+
+// Slot of an array_cache, only expiring caches store an expiry time.
+template<typename T, bool Expiring>
+struct cache_entry {
+    T value;
+
+    void expire_at(std::chrono::steady_clock::time_point) {}
+    bool expired(std::chrono::steady_clock::time_point) const {
+        return false;
+    }
+};
+
+template<typename T>
+struct cache_entry<T, true> {
+    T value;
+    std::chrono::steady_clock::time_point expires;
+
+    void expire_at(std::chrono::steady_clock::time_point time) {
+        expires = time;
+    }
+    bool expired(std::chrono::steady_clock::time_point now) const {
+        return expires <= now;
+    }
+};
+
+}
+
+/**
+ * Fixed capacity cache on top of an open address slot array. When
+ * the cache is full an insertion evicts an element chosen by the
+ * CLOCK algorithm, which keeps its reference bits in the slot flags.
+ * If Expiring is true, elements can expire a fixed time after they
+ * were inserted; expired elements are dropped lazily when they are
+ * found or passed by the clock hand. Caches that do not expire store
+ * no expiry time per slot. The cache never rehashes.
+ */
+template<typename K, typename V, bool Expiring = false>
+class array_cache {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = size_t;
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * Initializes an empty cache.
+     *
+     * @param capacity - maximum number of elements in the cache
+     * @param ttl - time after which an element expires, zero
+     * means elements never expire. Only an expiring cache accepts
+     * a ttl, otherwise std::invalid_argument is thrown.
+     */
+    explicit array_cache(
+            size_type capacity,
+            clock::duration ttl = clock::duration::zero())
+        : _slots(slot_count(capacity))
+    {
+        if(!Expiring && ttl != clock::duration::zero())
+            throw std::invalid_argument("array_cache: ttl needs an expiring cache");
+        
+        _capacity = capacity;
+        _ttl = ttl;
+        _hand = 0;
+        _hits = 0;
+        _misses = 0;
+        _evictions = 0;
+    }
+
+    /**
+     * Checks if the cache has no elements
+     *
+     * @return true if the cache is empty, false otherwise
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+    /**
+     * Returns the number of elements in the cache, including
+     * expired elements that were not dropped yet.
+     *
+     * @return The number of elements in the cache.
+     */
+    size_type size() const {
+        return _slots.size();
+    }
+    /**
+     * Returns the maximum number of elements in the cache.
+     *
+     * @return The capacity of the cache.
+     */
+    size_type capacity() const {
+        return _capacity;
+    }
+    /**
+     * Removes all elements from the cache. The statistics are kept.
+     */
+    void clear() {
+        smart_container<entry> empty_slots(_slots.capacity());
+        _slots = std::move(empty_slots);
+        _hand = 0;
+    }
+
+    /**
+     * Looks up the value cached for key and marks it as recently
+     * used. Counts as a hit or a miss.
+     *
+     * @param key - the key of the element to find
+     * @return Pointer to the cached value, or nullptr if the key
+     * is not cached or has expired.
+     */
+    V* find(const K& key) {
+        size_type i = find_element(key);
+        if(i != _slots.capacity() && expired(i)) {
+            erase_slot(i);
+            i = _slots.capacity();
+        }
+        if(i == _slots.capacity()) {
+            _misses++;
+            return nullptr;
+        }
+
+        _hits++;
+        _slots.reference(i, true);
+        return &_slots[i].value.second;
+    }
+
+    /**
+     * Returns the number of unexpired elements with key key, which
+     * is either 1 or 0. Does not count as a hit or a miss and does
+     * not mark the element as recently used.
+     *
+     * @param key - key value of the elements to count
+     * @return Number of elements with key key, that is
+     * either 1 or 0.
+     */
+    size_type count(const K& key) const {
+        size_type i = find_element(key);
+        if(i == _slots.capacity() || expired(i))
+            return 0;
+        return 1;
+    }
+
+    /**
+     * Caches value for key, replacing the value if key is cached
+     * already. Restarts the expiry time of the element. If the cache
+     * is full another element is evicted.
+     *
+     * @param key - element key to cache
+     * @param value - element value to cache
+     */
+    void insert_or_assign(const key_type& key, const mapped_type& value) {
+        if(_capacity == 0)
+            return;
+        
+        size_type i = find_element(key);
+        if(i == _slots.capacity()) {
+            if(size() >= _capacity) {
+                evict_one([](value_type&&) {});
+                _evictions++;
+            }
+
+            i = hash(key);
+            while (!_slots.free(i)) {
+                i = (i == _slots.capacity()-1) ? 0 : i + 1;
+            }
+            _slots[i].value.first = key;
+        }
+
+        entry& slot = _slots[i];
+        slot.value.second = value;
+        if(Expiring && _ttl != clock::duration::zero())
+            slot.expire_at(clock::now() + _ttl);
+        _slots.reference(i, true);
+    }
+
+    /**
+     * Removes the element (if one exists) with the key
+     * equivalent to key.
+     *
+     * @param key - key value of the elements to remove
+     * @return Number of elements removed.
+     */
+    size_type erase(const key_type& key) {
+        size_type i = find_element(key);
+        if(i == _slots.capacity())
+            return 0;
+
+        erase_slot(i);
+        return 1;
+    }
+
+    /**
+     * Evicts up to count elements chosen by the CLOCK algorithm, as an
+     * insertion into a full cache would, and hands each of them to 
+     * sink before it is removed. They do not count towards evictions().
+     *
+     * @param count - maximum number of elements to evict
+     * @param sink - callable as sink(value_type&&)
+     * @return Number of elements evicted.
+     */
+    template<typename Sink>
+    size_type evict(size_type count, Sink sink) {
+        size_type evicted = 0;
+        for(; evicted < count && !empty(); evicted++)
+            evict_one(sink);
+        return evicted;
+    }
+
+    /**
+     * @return Number of lookups that found an unexpired element.
+     */
+    size_type hits() const {
+        return _hits;
+    }
+    /**
+     * @return Number of lookups that found no unexpired element.
+     */
+    size_type misses() const {
+        return _misses;
+    }
+    /**
+     * @return Number of elements evicted to make room for new ones.
+     */
+    size_type evictions() const {
+        return _evictions;
+    }
+
+private:
+    using entry = detail::cache_entry<value_type, Expiring>;
+
+    size_type _capacity;
+    clock::duration _ttl;
+    size_type _hand;
+    size_type _hits;
+    size_type _misses;
+    size_type _evictions;
+    smart_container<entry> _slots;
+
+    // Keeps probe chains short, the slot array is sized for a 0.70 load.
+    static size_type slot_count(size_type capacity) {
+        return std::ceil(capacity / 0.70f) + 1;
+    }
+
+    size_type hash(const key_type& key) const {
+        size_t hash = std::hash<key_type>{}(key);
+        return hash % _slots.capacity();
+    }
+
+    size_type find_element(const key_type& key) const {
+        size_type i = hash(key);
+        while (!_slots.empty(i)) {
+            if (_slots[i].value.first == key)
+                return i;
+
+            i = (i == _slots.capacity()-1) ? 0 : i + 1;
+        }
+        return _slots.capacity();
+    }
+
+    bool expired(size_type i) const {
+        return Expiring && _ttl != clock::duration::zero()
+                && _slots[i].expired(clock::now());
+    }
+
+    /*
+     * Advances the clock hand to the first element that is expired or
+     * was not referenced since the hand last passed it, clearing
+     * reference bits on the way, and evicts that element after handing
+     * it to sink.
+     */
+    template<typename Sink>
+    void evict_one(Sink&& sink) {
+        while(true) {
+            _hand = (_hand == _slots.capacity()-1) ? 0 : _hand + 1;
+            if(_slots.free(_hand))
+                continue;
+            if(_slots.referenced(_hand) && !expired(_hand)) {
+                _slots.reference(_hand, false);
+                continue;
+            }
+
+            sink(std::move(_slots[_hand].value));
+            erase_slot(_hand);
+            return;
+        }
+    }
+
+    /*
+     * Removes the element in slot i without leaving a removed slot
+     * behind: following elements of the probe chain that may live in
+     * slot i are shifted back into it.
+     */
+    void erase_slot(size_type i) {
+        size_type j = i;
+        while(true) {
+            j = (j == _slots.capacity()-1) ? 0 : j + 1;
+            if(_slots.empty(j))
+                break;
+
+            size_type home = hash(_slots[j].value.first);
+            bool stays = (i <= j) ? (i < home && home <= j)
+                                  : (i < home || home <= j);
+            if(stays)
+                continue;
+
+            bool referenced = _slots.referenced(j);
+            _slots[i] = std::move(_slots[j]);
+            _slots.reference(i, referenced);
+            i = j;
+        }
+        _slots[i] = entry();
+        _slots.reset(i);
+    }
+};
+
+}
+
+#endif /* ARRAYCACHE_H */
+
@@ -9,14 +9,37 @@
 #define ARRAYMAP_H
 
 #include <utility>
+#include <algorithm>
 #include <cmath>
 #include <exception>
+#include <vector>
+#include <type_traits>
 #include "container.h"
+#include "frozenmap.h"
+#include "hashing.h"
+#include "probing.h"
 #include "iterator.h"
 
 namespace ljl {
 
-template<typename K, typename V>
+/**
+ * Decides whether array_map stores the full hash of every key beside 
+ * its slot. Probes then compare hashes before keys and rehashing does 
+ * not hash the keys again. Enabled for keys that are not trivially 
+ * copyable (e.g. std::string), where hashing and comparing is 
+ * expensive. Specialize it to override the choice for a key type.
+ */
+template<typename K>
+struct store_hash : std::integral_constant<bool, 
+        !std::is_trivially_copyable<K>::value> {};
+
+template<typename K, typename V, typename Probe = linear_probe>
+class array_map_snapshot;
+
+/*
+ * Probe selects the probe sequence, see probing.h.
+ */
+template<typename K, typename V, typename Probe = linear_probe>
 class array_map {
 public:
     using key_type = K;
@@ -27,11 +50,56 @@ public:
     using const_reference = const value_type&;
     using iterator = arraymap_iterator<value_type>;
     using const_iterator = arraymap_iterator<const value_type>;
+    using hasher = std::hash<K>;
+    
+    array_map() 
+        : _values(DEFAULT_CAPACITY), _hashes(hash_slots(DEFAULT_CAPACITY)) 
+    {
+        _maxLoad = 0.70f;
+        _minLoad = 0.0f;
+        _seed = random_seed();
+        _maxProbe = 0;
+        _reseedSize = 0;
+    }
     
-    array_map() : _values(32) {
+    /**
+     * Initializes the container like array_map() but allocates 
+     * its slot array according to policy, e.g. on huge pages or 
+     * interleaved over all NUMA nodes.
+     * 
+     * @param policy - how to allocate the slot array
+     */
+    explicit array_map(const allocation_policy& policy) 
+        : _policy(policy), _values(DEFAULT_CAPACITY, policy), 
+          _hashes(hash_slots(DEFAULT_CAPACITY), policy) 
+    {
         _maxLoad = 0.70f;
+        _minLoad = 0.0f;
+        _seed = random_seed();
+        _maxProbe = 0;
+        _reseedSize = 0;
     }
     
+    /**
+     * Copies the container. The copy shares the pages of the slot 
+     * array with other; each side copies a page only when it first 
+     * modifies it, so copying takes time in the number of pages 
+     * rather than the number of elements.
+     * 
+     * @param other - container to copy
+     */
+    array_map(const array_map& other) = default;
+    array_map(array_map&& other) = default;
+    /**
+     * Replaces the contents with a copy of other, sharing its slot 
+     * array pages like the copy constructor.
+     * 
+     * @param other - container to copy
+     * @return *this
+     */
+    array_map& operator=(const array_map& other) = default;
+    array_map& operator=(array_map&& other) = default;
+    
     /**
      * Checks if the container has no elements
      * 
@@ -62,8 +130,10 @@ public:
      * contained elements. May also invalidate past-the-end iterators.
      */
     void clear() {
-        smart_container<value_type> empty_container(32);
+        smart_container<value_type> empty_container(DEFAULT_CAPACITY, _policy);
         _values = std::move(empty_container);
+        container<size_type> empty_hashes(hash_slots(DEFAULT_CAPACITY), _policy);
+        _hashes = std::move(empty_hashes);
     }
     
     /**
@@ -83,19 +153,29 @@ public:
             const key_type& key, 
             const mapped_type& value) 
     {
-        size_type i = find_element(key);
+        return emplace_hashed(key, value, hash_code(key));
+    }
+    
+    /**
+     * Same as emplace, but uses hash instead of hashing key. This 
+     * and the other overloads taking a hash let a caller hash a key 
+     * once and use it with several containers.
+     * 
+     * @param key - element key to emplace
+     * @param value - element value to emplace
+     * @param hash - hash of key, must equal hash_function()(key)
+     * @return See emplace.
+     */
+    std::pair<iterator, bool> emplace_hashed(
+            const key_type& key, 
+            const mapped_type& value,
+            size_type hash) 
+    {
+        size_type i = find_element(key, hash);
         if(i != _values.capacity())
             return std::make_pair(iterator(&_values, i), false);
         
-        if(load_factor() > _maxLoad) {
-            rehash(_values.capacity() * 2);
-        }
-            
-        i = hash(key);
-        while (!_values.free(i)) {
-            i = (i == _values.capacity()-1) ? 0 : i + 1;
-        }
-        _values[i] = std::make_pair(key, value);
+        i = insert_new(value_type(key, value), hash);
             
         return std::make_pair(iterator(&_values, i), true);
     }
@@ -109,11 +189,30 @@ public:
      * @return Reference to the mapped value of the requested element
      */
     V& at(const K& key) {
-        return const_cast<V&>(static_cast<const array_map&>(*this).at(key));
+        return at(key, hash_code(key));
     }
     
     const V& at(const K& key) const {
-        size_type i = find_element(key);
+        return at(key, hash_code(key));
+    }
+    
+    /**
+     * Same as at, but uses hash instead of hashing key.
+     * 
+     * @param key - the key of the element to find
+     * @param hash - hash of key, must equal hash_function()(key)
+     * @return Reference to the mapped value of the requested element
+     */
+    V& at(const K& key, size_type hash) {
+        size_type i = find_element(key, hash);
+        if(i == _values.capacity())
+            throw std::out_of_range("Key not found");
+        
+        return _values[i].second;
+    }
+    
+    const V& at(const K& key, size_type hash) const {
+        size_type i = find_element(key, hash);
         if(i == _values.capacity())
             throw std::out_of_range("Key not found");
         
@@ -135,6 +234,21 @@ public:
     const_iterator find(const K& key) const {
         return const_iterator(&_values, find_element(key));
     }
+    
+    /**
+     * Same as find, but uses hash instead of hashing key.
+     * 
+     * @param key - key value of the element to search for
+     * @param hash - hash of key, must equal hash_function()(key)
+     * @return Iterator to the element, or end() if there is none.
+     */
+    iterator find(const K& key, size_type hash) {
+        return iterator(&_values, find_element(key, hash));
+    }
+    
+    const_iterator find(const K& key, size_type hash) const {
+        return const_iterator(&_values, find_element(key, hash));
+    }
 
     /**
      * Returns a reference to the value that is mapped to a 
@@ -148,20 +262,23 @@ public:
      * whose key is equivalent to key.
      */
     V& operator[](const K& key) {
-        int i = find_element(key);
+        return subscript_hashed(key, hash_code(key));
+    }
+    
+    /**
+     * Same as operator[], but uses hash instead of hashing key.
+     * 
+     * @param key - the key of the element to find
+     * @param hash - hash of key, must equal hash_function()(key)
+     * @return See operator[].
+     */
+    V& subscript_hashed(const K& key, size_type hash) {
+        size_type i = find_element(key, hash);
         if(i != _values.capacity())
             return _values[i].second;
         
-        if(load_factor() > _maxLoad) {
-            rehash(_values.capacity() * 2);
-        }
-            
-        i = hash(key);
-        while (!_values.free(i)) {
-            i = (i == _values.capacity()-1) ? 0 : i + 1;
-        }
+        i = insert_new(value_type(key, mapped_type()), hash);
         
-        _values[i].first = key;
         return _values[i].second;
     }
     
@@ -175,7 +292,19 @@ public:
      * either 1 or 0.
      */
     size_type count(const K& key) const {
-        if(find_element(key) == _values.capacity())
+        return count(key, hash_code(key));
+    }
+    
+    /**
+     * Same as count, but uses hash instead of hashing key.
+     * 
+     * @param key - key value of the elements to count
+     * @param hash - hash of key, must equal hash_function()(key)
+     * @return Number of elements with key key, that is 
+     * either 1 or 0.
+     */
+    size_type count(const K& key, size_type hash) const {
+        if(find_element(key, hash) == _values.capacity())
             return 0;
         return 1;
     }
@@ -196,17 +325,31 @@ public:
     /**
      * Removes the element (if one exists) with the key 
      * equivalent to key.
+     * If the load factor drops below the minimum load factor the 
+     * container shrinks, which invalidates all iterators.
      * 
      * @param key - key value of the elements to remove
      * @return Number of elements removed.
      */
     size_type erase(const key_type& key) {
-        int i = find_element(key);
+        return erase(key, hash_code(key));
+    }
+    
+    /**
+     * Same as erase, but uses hash instead of hashing key.
+     * 
+     * @param key - key value of the elements to remove
+     * @param hash - hash of key, must equal hash_function()(key)
+     * @return Number of elements removed.
+     */
+    size_type erase(const key_type& key, size_type hash) {
+        size_type i = find_element(key, hash);
         if(i == _values.capacity()) {
             return 0;
         }
         
         _values.remove(i);
+        shrink_if_sparse();
         return 1;
     }
     
@@ -228,12 +371,35 @@ public:
         return _maxLoad;
     }
     /**
-     * Sets the maximum load factor to ml.
+     * Sets the maximum load factor to ml. The minimum load factor 
+     * is capped at half of the new maximum (see min_load_factor).
      * 
      * @param ml - new maximum load factor setting
      */
     void max_load_factor(float ml) {
         _maxLoad = ml;
+        _minLoad = std::min(_minLoad, _maxLoad / 2);
+    }
+    /**
+     * Returns the load factor below which erasing an element 
+     * shrinks the container. Zero disables shrinking.
+     * 
+     * @return Returns current minimum load factor.
+     */
+    float min_load_factor() const {
+        return _minLoad;
+    }
+    /**
+     * Sets the minimum load factor to ml. When erasing drops the 
+     * load factor below ml the container shrinks so that its load 
+     * factor lies halfway between the minimum and the maximum load 
+     * factor. To avoid shrinking right after growing, ml is capped at 
+     * half of the maximum load factor.
+     * 
+     * @param ml - new minimum load factor setting, 0 disables shrinking
+     */
+    void min_load_factor(float ml) {
+        _minLoad = std::min(ml, _maxLoad / 2);
     }
     
     /**
@@ -243,19 +409,32 @@ public:
      * If the new capacity makes load factor more than 
      * maximum load factor (count < size() / max_load_factor()), 
      * then the new number of buckets is at least size() / max_load_factor().
+     * Probe policies that need a power of two capacity round it up.
      * 
      * @param count - new capacity of the container
      */
     void rehash(size_type count) {
-        smart_container<value_type> new_values(count);
+        count = Probe::capacity(std::max(count, min_capacity()));
+        smart_container<value_type> new_values(count, _policy);
         std::swap(_values, new_values);
+        container<size_type> new_hashes(hash_slots(count), _policy);
+        std::swap(_hashes, new_hashes);
+        _maxProbe = 0;
     
-        for(unsigned int i = 0; i < new_values.capacity(); i++)
+        // Elements on pages still shared with a copy are copied, the 
+        // others moved.
+        const smart_container<value_type>& old_values = new_values;
+        const container<size_type>& old_hashes = new_hashes;
+        for(unsigned int i = 0; i < old_values.capacity(); i++)
         {
-            if(!new_values.free(i))
+            if(!old_values.free(i))
             {
-                const reference entry = new_values[i];
-                emplace(entry.first, entry.second);
+                size_type h = store_hash<K>::value 
+                        ? old_hashes[i] : hash_code(old_values[i].first);
+                if(old_values.shared(i))
+                    insert_element(value_type(old_values[i]), h);
+                else
+                    insert_element(std::move(new_values[i]), h);
             }
         }
     }
@@ -263,7 +442,9 @@ public:
     /**
      * Sets the number of buckets to the number needed to accomodate
      * at least count elements without exceeding maximum load factor 
-     * and rehashes the container.
+     * and rehashes the container. With a prefaulting allocation 
+     * policy the new slot array is faulted in here rather than 
+     * during the following insertions.
      * 
      * @param count - new capacity of the container
      */
@@ -271,6 +452,158 @@ public:
         rehash(std::ceil(count / max_load_factor()));
     }
     
+    /**
+     * Reduces the capacity to the smallest one that holds the current 
+     * elements without exceeding the maximum load factor (but not 
+     * below the default capacity) and rehashes the container. 
+     * Invalidates all iterators.
+     */
+    void shrink_to_fit() {
+        rehash(std::max(DEFAULT_CAPACITY, min_capacity()));
+    }
+    
+    /**
+     * Merges every element of the container into target: keys that 
+     * target does not contain are inserted, for keys it does contain 
+     * combiner(target_value, value) is called. Walks the slot array 
+     * directly and reuses stored hashes.
+     * 
+     * @param target - container to merge into, must not be *this
+     * @param combiner - callable as combiner(V&, const V&)
+     */
+    template<typename Combiner>
+    void merge_into(array_map& target, Combiner combiner) const {
+        merge_into(target, combiner, 0, 1);
+    }
+    
+    /**
+     * Merges the elements whose key falls into partition part of 
+     * parts hash partitions into target, see merge_into above. The 
+     * partitions are disjoint, so several threads can merge different 
+     * partitions of the same sources into different targets at once.
+     * 
+     * @param target - container to merge into, must not be *this
+     * @param combiner - callable as combiner(V&, const V&)
+     * @param part - partition to merge, less than parts
+     * @param parts - number of partitions
+     */
+    template<typename Combiner>
+    void merge_into(array_map& target, Combiner combiner, 
+            size_type part, size_type parts) const 
+    {
+        for(size_type i = 0; i < _values.capacity(); i++) {
+            if(_values.free(i))
+                continue;
+            
+            size_type h = stored_hash(i);
+            if(parts > 1 && mix_hash(h) % parts != part)
+                continue;
+            merge_slot(target, combiner, i, h);
+        }
+    }
+    
+    /**
+     * Sorts the elements into parts hash partitions (the same ones 
+     * merge_into uses) in a single pass over the slot array.
+     * 
+     * @param parts - number of partitions
+     * @return For every partition the slot positions of its elements, 
+     * valid for merge_slots until the container is modified.
+     */
+    std::vector<std::vector<size_type>> partition_slots(size_type parts) const {
+        std::vector<std::vector<size_type>> slots(parts);
+        for(size_type i = 0; i < _values.capacity(); i++) {
+            if(!_values.free(i))
+                slots[parts > 1 ? mix_hash(stored_hash(i)) % parts : 0].push_back(i);
+        }
+        return slots;
+    }
+    
+    /**
+     * Merges the elements at the given slot positions into target, 
+     * see merge_into. Merging the partitions from partition_slots 
+     * with merge_slots walks the slot array once instead of once 
+     * per partition.
+     * 
+     * @param target - container to merge into, must not be *this
+     * @param combiner - callable as combiner(V&, const V&)
+     * @param slots - slot positions from partition_slots
+     */
+    template<typename Combiner>
+    void merge_slots(array_map& target, Combiner combiner, 
+            const std::vector<size_type>& slots) const 
+    {
+        for(size_type i : slots)
+            merge_slot(target, combiner, i, stored_hash(i));
+    }
+    
+    /**
+     * Returns the function used to hash keys. Hashes passed to the 
+     * overloads taking a hash must come from it.
+     * 
+     * @return The hash function.
+     */
+    hasher hash_function() const {
+        return hasher();
+    }
+    
+    /**
+     * Returns the longest probe sequence an insertion walked since 
+     * the container was last rehashed.
+     * 
+     * @return The maximum probe length.
+     */
+    size_type max_probe_length() const {
+        return _maxProbe;
+    }
+    
+    /**
+     * Returns the policy the slot array is allocated with.
+     * 
+     * @return The allocation policy of the container.
+     */
+    allocation_policy get_allocation_policy() const {
+        return _policy;
+    }
+    
+    /**
+     * Returns a read-only copy of the container that shares its slot 
+     * pages with the container (see the copy constructor). The 
+     * snapshot may be read by other threads while this container 
+     * keeps being modified; only the pages touched by those 
+     * modifications are duplicated.
+     * 
+     * @return Returns the snapshot of the container.
+     */
+    array_map_snapshot<K, V, Probe> snapshot() const {
+        return array_map_snapshot<K, V, Probe>(*this);
+    }
+    
+    /**
+     * Builds a read-only copy of the container backed by a minimal 
+     * perfect hash function. The copy stores its elements without 
+     * empty slots and answers every lookup with a single element probe.
+     * Keys whose hashes equal that of another key are the exception: 
+     * they are kept in a small overflow area searched after the probe.
+     * 
+     * @param fingerprints - store a fingerprint per element so most 
+     * absent keys are rejected without a key comparison
+     * @param threads - number of threads to build with, 0 means one 
+     * per hardware thread
+     * @return Returns the frozen copy of the container.
+     */
+    frozen_map<K, V> freeze(bool fingerprints = false, 
+            unsigned int threads = 0) const 
+    {
+        std::vector<value_type> entries;
+        entries.reserve(size());
+        for(size_type i = 0; i < _values.capacity(); i++) {
+            if(!_values.free(i))
+                entries.push_back(_values[i]);
+        }
+        return frozen_map<K, V>(std::move(entries), fingerprints, threads);
+    }
+    
     /**
      * Returns an iterator to the first element of the container.
      * If the container is empty, the returned iterator will be 
@@ -309,24 +642,248 @@ public:
     }
         
 private:
+    static const size_type DEFAULT_CAPACITY = 32;
+    
     float _maxLoad;
+    float _minLoad;
+    allocation_policy _policy;
     smart_container<value_type> _values;
+    // Hash of the key in the same slot of _values, if store_hash<K>.
+    container<size_type> _hashes;
+    // Mixed into every hash so that slot positions can not be predicted.
+    size_type _seed;
+    size_type _maxProbe;
+    size_type _reseedSize;
+    
+    static size_type hash_slots(size_type capacity) {
+        return store_hash<K>::value ? capacity : 0;
+    }
+    
+    size_type min_capacity() const {
+        size_type count = std::ceil(size() / max_load_factor());
+        return std::max(count, size() + 1);
+    }
+    
+    /*
+     * Erased slots keep probe chains intact and therefore count towards 
+     * the load. When mostly erased slots push the table over the maximum 
+     * load factor it is rehashed in place instead of doubled.
+     */
+    void grow_if_needed() {
+        float used = (float)_values.used() / (float)_values.capacity();
+        if(used <= _maxLoad)
+            return;
+        
+        if(load_factor() > _maxLoad / 2)
+            rehash(_values.capacity() * 2);
+        else
+            rehash(_values.capacity());
+    }
+    
+    void shrink_if_sparse() {
+        if(_minLoad <= 0.0f || _values.capacity() <= DEFAULT_CAPACITY)
+            return;
+        if(load_factor() >= _minLoad)
+            return;
+        
+        size_type count = std::ceil(size() / ((_minLoad + _maxLoad) / 2));
+        rehash(std::max(DEFAULT_CAPACITY, count));
+    }
 
-    size_type hash(const key_type& key) const {
-        size_t hash = std::hash<key_type>{}(key);
-        return hash % _values.capacity();
+    size_type stored_hash(size_type i) const {
+        return store_hash<K>::value ? _hashes[i] : hash_code(_values[i].first);
+    }
+    
+    template<typename Combiner>
+    void merge_slot(array_map& target, Combiner& combiner, 
+            size_type i, size_type h) const 
+    {
+        const value_type& entry = _values[i];
+        size_type j = target.find_element(entry.first, h);
+        if(j != target._values.capacity())
+            combiner(target._values[j].second, entry.second);
+        else
+            target.insert_new(value_type(entry), h);
+    }
+    
+    size_type hash_code(const key_type& key) const {
+        return hasher{}(key);
     }
     
     size_type find_element(const key_type& key) const {
-        int i = hash(key);
-        while (!_values.empty(i)) {
-            if (!_values.removed(i) && _values[i].first == key) 
+        return find_element(key, hash_code(key));
+    }
+    
+    size_type find_element(const key_type& key, size_type h) const {
+        Probe probe = start(h);
+        for(; !_values.empty(probe.index()); probe.next()) {
+            size_type i = probe.index();
+            if (!_values.removed(i) 
+                    && (!store_hash<K>::value || _hashes[i] == h) 
+                    && _values[i].first == key) 
                 return i;
-            
-            i = (i == _values.size()-1) ? 0 : i + 1;
         }
         return _values.capacity();
     }
+    
+    /*
+     * Places an element whose key is not in the container yet into 
+     * the first free slot of its probe sequence.
+     */
+    size_type insert_element(value_type&& value, size_type h) {
+        Probe probe = start(h);
+        size_type probes = 0;
+        for(; !_values.free(probe.index()); probe.next())
+            probes++;
+        
+        size_type i = probe.index();
+        _values[i] = std::move(value);
+        if(store_hash<K>::value)
+            _hashes[i] = h;
+        _maxProbe = std::max(_maxProbe, probes);
+        return i;
+    }
+    
+    /*
+     * Inserts a new element, growing first if needed. If the insertion 
+     * walked an unusually long probe sequence the keys cluster under 
+     * the current seed, so the container is rehashed with a new one. 
+     * To bound the cost when keys collide regardless of the seed, the 
+     * next reseed waits until the container has doubled in size.
+     */
+    size_type insert_new(value_type&& value, size_type h) {
+        grow_if_needed();
+        size_type i = insert_element(std::move(value), h);
+        if(_maxProbe <= probe_limit() || size() < 2 * _reseedSize)
+            return i;
+        
+        key_type key = _values[i].first;
+        _seed = random_seed();
+        _reseedSize = size();
+        rehash(_values.capacity());
+        return find_element(key, h);
+    }
+    
+    Probe start(size_type h) const {
+        return Probe(mix_hash(h ^ _seed), _values.capacity());
+    }
+    
+    size_type probe_limit() const {
+        size_type bits = 0;
+        for(size_type c = _values.capacity(); c > 1; c >>= 1)
+            bits++;
+        return 16 * bits + 32;
+    }
+};
+
+template<typename K, typename V, typename Probe>
+const typename array_map<K, V, Probe>::size_type 
+        array_map<K, V, Probe>::DEFAULT_CAPACITY;
+
+/**
+ * Read-only copy of an array_map taken by array_map::snapshot(). It 
+ * shares the slot pages of the map it was taken from and only offers 
+ * lookups and iteration, so it never copies a page itself. A snapshot 
+ * may be read by several threads at once.
+ */
+template<typename K, typename V, typename Probe>
+class array_map_snapshot {
+public:
+    using map_type = array_map<K, V, Probe>;
+    using key_type = typename map_type::key_type;
+    using mapped_type = typename map_type::mapped_type;
+    using value_type = typename map_type::value_type;
+    using size_type = typename map_type::size_type;
+    using const_reference = typename map_type::const_reference;
+    using iterator = typename map_type::const_iterator;
+    using const_iterator = typename map_type::const_iterator;
+    using hasher = typename map_type::hasher;
+    
+    /**
+     * @return true if the snapshot is empty, false otherwise
+     */
+    bool empty() const {
+        return _map.empty();
+    }
+    /**
+     * @return The number of elements in the snapshot.
+     */
+    size_type size() const {
+        return _map.size();
+    }
+    /**
+     * @return The capacity of the snapshot.
+     */
+    size_type capacity() const {
+        return _map.capacity();
+    }
+    
+    /**
+     * Returns a reference to the mapped value of the element 
+     * with a key equivalent to key. If no such element exists, 
+     * an exception of type std::out_of_range is thrown.
+     * 
+     * @param key - the key of the element to find
+     * @return Reference to the mapped value of the requested element
+     */
+    const V& at(const K& key) const {
+        return _map.at(key);
+    }
+    const V& at(const K& key, size_type hash) const {
+        return _map.at(key, hash);
+    }
+    
+    /**
+     * Finds an element with key equivalent to key.
+     * 
+     * @param key - key value of the element to search for
+     * @return Iterator to the element, or end() if there is none.
+     */
+    const_iterator find(const K& key) const {
+        return _map.find(key);
+    }
+    const_iterator find(const K& key, size_type hash) const {
+        return _map.find(key, hash);
+    }
+    
+    /**
+     * @param key - key value of the elements to count
+     * @return Number of elements with key key, that is 
+     * either 1 or 0.
+     */
+    size_type count(const K& key) const {
+        return _map.count(key);
+    }
+    size_type count(const K& key, size_type hash) const {
+        return _map.count(key, hash);
+    }
+    
+    /**
+     * @return The hash function of the map the snapshot was taken from.
+     */
+    hasher hash_function() const {
+        return _map.hash_function();
+    }
+    
+    const_iterator begin() const {
+        return _map.begin();
+    }
+    const_iterator cbegin() const {
+        return begin();
+    }
+    const_iterator end() const {
+        return _map.end();
+    }
+    const_iterator cend() const {
+        return end();
+    }
+    
+private:
+    friend class array_map<K, V, Probe>;
+    
+    map_type _map;
+    
+    explicit array_map_snapshot(const map_type& map) : _map(map) {}
 };
 
 }
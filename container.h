@@ -9,33 +9,86 @@
 #define CONTAINER_H
 
 #include<cassert>
+#include<new>
+#include<vector>
+#include<memory>
+#include<atomic>
+#include<algorithm>
+#include "allocation.h"
+
+// Keeps rarely taken paths from being inlined into hot ones.
+#ifdef __GNUC__
+#define LJL_NOINLINE __attribute__((noinline))
+#else
+#define LJL_NOINLINE
+#endif
 
 namespace ljl {
 
+/*
+ * Slot array that copies share copy-on-write. The slot array is one 
+ * contiguous block made up of fixed-size pages. Copying a container 
+ * only copies the page pointers, and a page is copied the first time 
+ * it is written to while shared. Nothing is modified by a copy, so 
+ * copies may be taken while other threads read the container.
+ * 
+ * A write only checks reference counts. Seeing a count of one is 
+ * followed by an acquire fence, which orders the write after the reads 
+ * of a copy that dropped its reference on another thread.
+ */
 template<typename T>
 class container {
 public:
     container() = delete;
-    container(size_t capacity) {
-        _data = new T[capacity];
+    container(size_t capacity, 
+            const allocation_policy& policy = allocation_policy()) 
+    {
         _capacity = capacity;
+        _policy = policy;
+        _shift = page_shift(policy);
+        _mask = ((size_t)1 << _shift) - 1;
+        
+        _block = std::make_shared<block>(capacity, policy);
+        _flat = _block->data;
+        size_t page_slots = (size_t)1 << _shift;
+        for(size_t first = 0; first < capacity; first += page_slots) {
+            size_t count = std::min(page_slots, capacity - first);
+            _pages.push_back(std::make_shared<page>(_block.get(), first, count));
+            _data.push_back(_pages.back()->data);
+        }
     }
+    container(const container<T>& other) = default;
     container(container<T>&& other) {
-        _data = other._data;
+        _flat = other._flat;
+        _block = std::move(other._block);
+        _pages = std::move(other._pages);
+        _data = std::move(other._data);
         _capacity = other._capacity;
+        _policy = other._policy;
+        _shift = other._shift;
+        _mask = other._mask;
         
-        other._data = nullptr;
+        other._flat = nullptr;
         other._capacity = 0;
     }
     
+    container<T>& operator=(const container<T>& rhs) {
+        container<T> copy(rhs);
+        return *this = std::move(copy);
+    }
     container<T>& operator=(container<T>&& rhs) {
-        if(_data != nullptr)
-            delete[] _data;
-            
-        _data = rhs._data;
+        release();
+        _flat = rhs._flat;
+        // The pages go first, the old ones may point into the old block.
+        _pages = std::move(rhs._pages);
+        _data = std::move(rhs._data);
+        _block = std::move(rhs._block);
         _capacity = rhs._capacity;
+        _policy = rhs._policy;
+        _shift = rhs._shift;
+        _mask = rhs._mask;
         
-        rhs._data = nullptr;
+        rhs._flat = nullptr;
         rhs._capacity = 0;
         
         return *this;
@@ -43,11 +96,26 @@ public:
     
     virtual T& operator[](unsigned int i) {
         assert(i >= 0 && i < _capacity);
-        return _data[i];
+        if(_flat != nullptr && exclusive())
+            return _flat[i];
+        return paged(i);
     }
     virtual const T& operator[](unsigned int i) const {
         assert(i >= 0 && i < _capacity);
-        return _data[i];
+        if(_flat != nullptr)
+            return _flat[i];
+        return _data[(size_t)i >> _shift][i & _mask];
+    }
+    
+    /*
+     * Whether slot i may be shared with a copy, in which case writing 
+     * to it copies its page.
+     */
+    bool shared(unsigned int i) const {
+        assert(i >= 0 && i < _capacity);
+        if(_flat != nullptr)
+            return _block.use_count() > 1;
+        return _pages[(size_t)i >> _shift].use_count() > 1;
     }
     
     size_t capacity() const {
@@ -55,60 +123,181 @@ public:
     }
     
     virtual ~container() {
-        if(_data != nullptr)
-            delete[] _data;
+        release();
     }
         
 private:
-    T* _data;
+    // Pages on normal memory are 1 MB, on huge pages one huge page.
+    static const size_t PAGE_BYTES = 1024 * 1024;
+    
+    // The memory of the slot array as allocated. Its elements belong 
+    // to the pages covering it.
+    struct block {
+        block(size_t count, const allocation_policy& policy) {
+            memory = allocate_pages(count * sizeof(T), policy);
+            data = static_cast<T*>(memory.data);
+            released = false;
+        }
+        block(const block&) = delete;
+        block& operator=(const block&) = delete;
+        
+        ~block() {
+            release_pages(memory);
+        }
+        
+        T* data;
+        allocation memory;
+        // Set when the pages of the block die with the block.
+        bool released;
+    };
+    
+    struct page {
+        // A page of the block.
+        page(block* owner, size_t first, size_t count) {
+            this->owner = owner;
+            data = owner->data + first;
+            this->count = count;
+            memory = allocation{nullptr, 0, false};
+            for(size_t i = 0; i < count; i++)
+                new (&data[i]) T();
+        }
+        // A private copy of another page.
+        page(const page& other, const allocation_policy& policy) {
+            owner = nullptr;
+            memory = allocate_pages(other.count * sizeof(T), policy);
+            data = static_cast<T*>(memory.data);
+            count = other.count;
+            for(size_t i = 0; i < count; i++)
+                new (&data[i]) T(other.data[i]);
+        }
+        page(const page&) = delete;
+        page& operator=(const page&) = delete;
+        
+        ~page() {
+            for(size_t i = 0; i < count; i++)
+                data[i].~T();
+            // Pages of the block return their memory early when a copy 
+            // keeps the block alive.
+            if(owner != nullptr && !owner->released)
+                discard_pages(data, count * sizeof(T));
+            release_pages(memory);
+        }
+        
+        T* data;
+        size_t count;
+        allocation memory;
+        block* owner;
+    };
+    
+    // Elements of the block while the container writes to the block 
+    // in place, nullptr once it has copied a page.
+    T* _flat;
+    // Shared with all copies. Declared before the pages, which point 
+    // into it and are therefore destroyed first.
+    std::shared_ptr<block> _block;
+    std::vector<std::shared_ptr<page>> _pages;
+    // Element pointers of _pages, kept separately to save an indirection.
+    std::vector<T*> _data;
     size_t _capacity;
+    allocation_policy _policy;
+    unsigned int _shift;
+    size_t _mask;
+    
+    static unsigned int page_shift(const allocation_policy& policy) {
+        size_t bytes = PAGE_BYTES;
+        if(policy.pages == page_size::huge_2mb)
+            bytes = (size_t)1 << 21;
+        else if(policy.pages == page_size::huge_1gb)
+            bytes = (size_t)1 << 30;
+        
+        unsigned int shift = 0;
+        while(((size_t)2 << shift) * sizeof(T) <= bytes)
+            shift++;
+        return shift;
+    }
+    
+    // Whether no copy shares the block.
+    bool exclusive() const {
+        if(_block.use_count() > 1)
+            return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+    
+    // Lets the pages of the block die without returning their memory 
+    // when the block is about to be freed anyway.
+    void release() {
+        if(_block && exclusive())
+            _block->released = true;
+    }
+    
+    LJL_NOINLINE T& paged(unsigned int i) {
+        _flat = nullptr;
+        size_t p = (size_t)i >> _shift;
+        if(_pages[p].use_count() > 1) {
+            _pages[p] = std::make_shared<page>(*_pages[p], _policy);
+            _data[p] = _pages[p]->data;
+        } else {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return _data[p][i & _mask];
+    }
 };
 
 template<typename T>
 class smart_container : public container<T> {
 public:    
     smart_container() = delete;
-    smart_container(size_t capacity) : container<T>(capacity) {
-        _empty = new bool[capacity];
-        _removed = new bool[capacity];
+    smart_container(size_t capacity, 
+            const allocation_policy& policy = allocation_policy()) 
+        : container<T>(capacity, policy), _flags(capacity, policy)
+    {
         for(unsigned int i = 0; i < capacity; i++) {
-            _empty[i] = true;
-            _removed[i] = false;
+            _flags[i] = EMPTY;
         }
         
         _size = 0;
+        _used = 0;
     }
-    smart_container(smart_container<T>&& other) : container<T>(std::move(other)) {
-        _empty = other._empty;
-        other._empty = nullptr;
-        _removed = other._removed;
-        other._removed = nullptr;
-        
+    smart_container(const smart_container<T>& other) 
+        : container<T>(other), _flags(other._flags) 
+    {
+        _size = other._size;
+        _used = other._used;
+    }
+    smart_container(smart_container<T>&& other) 
+        : container<T>(std::move(other)), _flags(std::move(other._flags)) 
+    {
         _size = other._size;
         other._size = 0;
+        _used = other._used;
+        other._used = 0;
     }
     
+    smart_container<T>& operator=(const smart_container<T>& rhs) {
+        smart_container<T> copy(rhs);
+        return *this = std::move(copy);
+    }
     smart_container<T>& operator=(smart_container<T>&& rhs) {
         container<T>::operator=(std::move(rhs));
-        
-        _empty = rhs._empty;
-        rhs._empty = nullptr;
-        _removed = rhs._removed;
-        rhs._removed = nullptr;
+        _flags = std::move(rhs._flags);
         
         _size = rhs._size;
         rhs._size = 0;
+        _used = rhs._used;
+        rhs._used = 0;
         
         return *this;
     }
     T& operator[](unsigned int i) override {
         assert(i >= 0 && i < container<T>::capacity());
 
-        if(free(i))
+        if(free(i)) {
             _size++;
-        
-        _empty[i] = false;
-        _removed[i] = false;
+            if(empty(i))
+                _used++;
+            _flags[i] &= ~(EMPTY | REMOVED);
+        }
         
         return container<T>::operator[](i);
     }
@@ -122,40 +311,64 @@ public:
             return;
         
         _size--;
-        _removed[i] = true;
+        _flags[i] = REMOVED;
+    }
+    /*
+     * Turns slot i back into an empty slot. Only valid when no probe 
+     * chain passes through i anymore, e.g. after a backward shift.
+     */
+    void reset(unsigned int i) {
+        assert(i >= 0 && i < container<T>::capacity());
+        if(!free(i))
+            _size--;
+        if(!empty(i))
+            _used--;
+        
+        _flags[i] = EMPTY;
     }
     
     bool empty(unsigned int i) const {
         assert(i >= 0 && i < container<T>::capacity());
-        return _empty[i];
+        return _flags[i] & EMPTY;
     }
     bool removed(unsigned int i) const {
         assert(i >= 0 && i < container<T>::capacity());
-        return _removed[i];
+        return _flags[i] & REMOVED;
     }
     bool free(unsigned int i) const {
-        return empty(i) || removed(i);
+        return _flags[i] & (EMPTY | REMOVED);
+    }
+    
+    void reference(unsigned int i, bool referenced) {
+        assert(i >= 0 && i < container<T>::capacity());
+        if(referenced)
+            _flags[i] |= REFERENCED;
+        else
+            _flags[i] &= ~REFERENCED;
+    }
+    bool referenced(unsigned int i) const {
+        assert(i >= 0 && i < container<T>::capacity());
+        return _flags[i] & REFERENCED;
     }
     
     size_t size() const {
         return _size;
     }
-    
-    virtual ~smart_container() {
-        if(_empty != nullptr)
-            delete[] _empty;
-            
-        if(_removed != nullptr)
-            delete[] _removed;
+    size_t used() const {
+        return _used;
     }
     
 private:
-    bool* _empty;
-    bool* _removed;
+    static const unsigned char EMPTY = 1;
+    static const unsigned char REMOVED = 2;
+    // Set when the slot was accessed, used by CLOCK eviction.
+    static const unsigned char REFERENCED = 4;
+    
+    container<unsigned char> _flags;
     size_t _size;
+    size_t _used;
 };
 
-
 }
 
 #endif /* CONTAINER_H */
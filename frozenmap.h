@@ -0,0 +1,509 @@
+/*
+ * File:   frozenmap.h
+ */
+
+#ifndef FROZENMAP_H
+#define FROZENMAP_H
+
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include "hashing.h"
+
+namespace ljl {
+
+/**
+ * Read-only map backed by a minimal perfect hash function
+ * (hash-and-displace). The elements are stored densely without any
+ * empty slots; a lookup reads one displacement and then exactly one
+ * element. Optionally a one byte fingerprint per element rejects most
+ * absent keys without comparing keys.
+ *
+ * Large maps are split by the high bits of the mixed key hash into
+ * partitions of about PARTITION_KEYS keys, each with its own seed,
+ * displacements and range of elements. The partitions are built
+ * independently on several threads; a lookup additionally reads the
+ * small partition table.
+ *
+ * Distinct keys with equal hashes cannot be told apart by the hash
+ * function. All but the first of them are kept in a small overflow
+ * area after the partitions, which lookups search when the key in the
+ * element slot does not match.
+ */
+template<typename K, typename V>
+class frozen_map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = size_t;
+    using const_reference = const value_type&;
+    using const_iterator = const value_type*;
+    using iterator = const_iterator;
+
+    frozen_map() : _bits(0) {}
+
+    /**
+     * Builds the perfect hash function over the given elements. The
+     * keys must be unique.
+     *
+     * @param entries - elements to store
+     * @param fingerprints - whether to store a fingerprint per element
+     * @param threads - number of threads to build with, 0 means one 
+     * per hardware thread
+     */
+    frozen_map(std::vector<value_type>&& entries, bool fingerprints = false,
+            unsigned int threads = 0)
+        : _bits(0)
+    {
+        if(threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        build(std::move(entries), fingerprints, threads);
+    }
+
+    /**
+     * Checks if the container has no elements
+     *
+     * @return true if the container is empty, false otherwise
+     */
+    bool empty() const {
+        return _entries.empty();
+    }
+    /**
+     * Returns the number of elements in the container
+     *
+     * @return The number of elements in the container.
+     */
+    size_type size() const {
+        return _entries.size();
+    }
+
+    /**
+     * Returns a reference to the mapped value of the element
+     * with a key equivalent to key. If no such element exists,
+     * an exception of type std::out_of_range is thrown.
+     *
+     * @param key - the key of the element to find
+     * @return Reference to the mapped value of the requested element
+     */
+    const V& at(const K& key) const {
+        size_type i = find_element(key);
+        if(i == _entries.size())
+            throw std::out_of_range("Key not found");
+
+        return _entries[i].second;
+    }
+
+    /**
+     * Finds an element with key equivalent to key.
+     *
+     * @param key - key value of the element to search for
+     * @return Iterator to an element with key equivalent
+     * to key. If no such element is found, past-the-end
+     * (see end()) iterator is returned.
+     */
+    const_iterator find(const K& key) const {
+        return begin() + find_element(key);
+    }
+
+    /**
+     * Returns the number of elements with key that compares
+     * equal to the specified argument key, which is either
+     * 1 or 0.
+     *
+     * @param key - key value of the elements to count
+     * @return Number of elements with key key, that is
+     * either 1 or 0.
+     */
+    size_type count(const K& key) const {
+        if(find_element(key) == _entries.size())
+            return 0;
+        return 1;
+    }
+
+    const_iterator begin() const {
+        return _entries.data();
+    }
+    const_iterator cbegin() const {
+        return begin();
+    }
+    const_iterator end() const {
+        return _entries.data() + _entries.size();
+    }
+    const_iterator cend() const {
+        return end();
+    }
+
+private:
+    // Displacements with this bit set hold the slot of a single key bucket.
+    static const std::uint32_t DIRECT = 0x80000000u;
+    static const std::uint32_t MAX_DISPLACEMENT = 1u << 24;
+    static const size_type BUCKET_SIZE = 4;
+    // Smaller inputs are not worth starting threads for.
+    static const size_type PARALLEL_MIN = 1 << 16;
+    // Average number of keys per partition the partition count aims for.
+    static const size_type PARTITION_KEYS = 1 << 16;
+
+    // Perfect hash function over the keys of one partition.
+    struct partition {
+        std::uint64_t seed;
+        // Range of the partition's elements in _entries.
+        std::uint32_t first;
+        std::uint32_t size;
+        // Range of the partition's displacements in _displacements.
+        std::uint32_t first_bucket;
+        std::uint32_t buckets;
+    };
+
+    std::vector<value_type> _entries;
+    std::vector<partition> _partitions;
+    std::vector<std::uint32_t> _displacements;
+    std::vector<unsigned char> _fingerprints;
+    // Sorted hashes of the overflow elements, which are the last 
+    // _overflow.size() elements of _entries.
+    std::vector<std::uint64_t> _overflow;
+    // Number of high hash bits that select the partition.
+    unsigned int _bits;
+
+    // The mixed hash of a key. The functions below all take this value.
+    static std::uint64_t key_hash(const key_type& key) {
+        return mix_hash(std::hash<key_type>{}(key));
+    }
+
+    size_type partition_of(std::uint64_t h) const {
+        return _bits == 0 ? 0 : h >> (64 - _bits);
+    }
+
+    // Maps the high 32 bits of a mixed hash onto [0, n) without a division.
+    static size_type reduce(std::uint64_t x, std::uint32_t n) {
+        return ((x >> 32) * n) >> 32;
+    }
+
+    static size_type bucket(const partition& part, std::uint64_t h) {
+        return reduce(h * part.seed, part.buckets);
+    }
+
+    static size_type slot(const partition& part, std::uint64_t h, std::uint32_t d) {
+        if(d & DIRECT)
+            return d & ~DIRECT;
+        return reduce(mix_hash(h + part.seed + (d + 1) * 0x9e3779b97f4a7c15ULL), part.size);
+    }
+
+    // Uses the low bits, which select neither partition nor bucket.
+    static unsigned char fingerprint(std::uint64_t h) {
+        return h;
+    }
+
+    size_type find_element(const key_type& key) const {
+        if(_entries.empty())
+            return 0;
+
+        std::uint64_t h = key_hash(key);
+        const partition& part = _partitions[partition_of(h)];
+        if(part.size == 0)
+            return _entries.size();
+
+        std::uint32_t d = _displacements[part.first_bucket + bucket(part, h)];
+        size_type i = part.first + slot(part, h, d);
+        if(!_fingerprints.empty() && _fingerprints[i] != fingerprint(h))
+            return _entries.size();
+        // Tested first so that the common case stays free of a branch 
+        // on the key comparison.
+        if(_overflow.empty())
+            return _entries[i].first == key ? i : _entries.size();
+        if(_entries[i].first == key)
+            return i;
+        return find_overflow(key, h);
+    }
+
+    size_type find_overflow(const key_type& key, std::uint64_t h) const {
+        auto range = std::equal_range(_overflow.begin(), _overflow.end(), h);
+        size_type first = _entries.size() - _overflow.size();
+        for(auto it = range.first; it != range.second; ++it) {
+            size_type i = first + (it - _overflow.begin());
+            if(_entries[i].first == key)
+                return i;
+        }
+        return _entries.size();
+    }
+
+    /*
+     * Calls body(first, last) on consecutive ranges covering [0, n), 
+     * one range per thread.
+     */
+    template<typename Body>
+    static void parallel_for(size_type n, unsigned int threads, Body body) {
+        if(threads <= 1 || n < PARALLEL_MIN) {
+            body(size_type(0), n);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        size_type chunk = (n + threads - 1) / threads;
+        for(size_type first = chunk; first < n; first += chunk)
+            workers.emplace_back(body, first, std::min(n, first + chunk));
+        body(size_type(0), std::min(n, chunk));
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+
+    /*
+     * Sorts the indexes [0, group_of.size()) by group, keeping their 
+     * order within a group. Afterwards the indexes of group g are 
+     * order[start[g]] to order[start[g + 1] - 1].
+     */
+    static void group_by(const std::vector<std::uint32_t>& group_of, size_type groups,
+            std::vector<size_type>& order, std::vector<size_type>& start)
+    {
+        start.assign(groups + 1, 0);
+        for(std::uint32_t g : group_of)
+            start[g + 1]++;
+        for(size_type g = 0; g < groups; g++)
+            start[g + 1] += start[g];
+        std::vector<size_type> fill(start.begin(), start.end() - 1);
+        order.resize(group_of.size());
+        for(size_type i = 0; i < group_of.size(); i++)
+            order[fill[group_of[i]]++] = i;
+    }
+
+    void build(std::vector<value_type>&& entries, bool fingerprints,
+            unsigned int threads)
+    {
+        _entries.swap(entries);
+        size_type n = _entries.size();
+        if(n == 0)
+            return;
+        if(n >= DIRECT)
+            throw std::length_error("Too many elements for frozen_map");
+
+        std::vector<std::uint64_t> hashes(n);
+        std::vector<std::uint32_t> partition_index(n);
+        _bits = 0;
+        while((n >> _bits) > PARTITION_KEYS)
+            _bits++;
+        parallel_for(n, threads, [&](size_type first, size_type last) {
+            for(size_type i = first; i < last; i++) {
+                hashes[i] = key_hash(_entries[i].first);
+                partition_index[i] = partition_of(hashes[i]);
+            }
+        });
+
+        size_type parts = size_type(1) << _bits;
+        std::vector<size_type> members;
+        std::vector<size_type> start;
+        group_by(partition_index, parts, members, start);
+        std::vector<std::uint32_t>().swap(partition_index);
+
+        // Each partition places its keys on its own slots, numbered 
+        // from 0, and its own displacements. Threads take the next 
+        // partition until none is left.
+        _partitions.assign(parts, partition());
+        std::vector<std::vector<std::uint32_t>> displacements(parts);
+        std::vector<std::vector<size_type>> placed(parts);
+        std::vector<std::vector<size_type>> overflow(parts);
+        std::atomic<size_type> next(0);
+        auto worker = [&]() {
+            for(size_type p; (p = next.fetch_add(1)) < parts; ) {
+                build_partition(p, members.data() + start[p], start[p + 1] - start[p],
+                        hashes, displacements[p], placed[p], overflow[p]);
+            }
+        };
+        std::vector<std::thread> workers;
+        unsigned int count = n < PARALLEL_MIN ? 1 : std::min<size_type>(threads, parts);
+        for(unsigned int t = 1; t < count; t++)
+            workers.emplace_back(worker);
+        worker();
+        for(std::thread& w : workers)
+            w.join();
+
+        // Lay the partitions out one after another, followed by the 
+        // overflow elements ordered by hash.
+        size_type first = 0;
+        size_type first_bucket = 0;
+        std::vector<size_type> spilled;
+        for(size_type p = 0; p < parts; p++) {
+            partition& part = _partitions[p];
+            part.first = first;
+            part.first_bucket = first_bucket;
+            first += part.size;
+            first_bucket += part.buckets;
+            spilled.insert(spilled.end(), overflow[p].begin(), overflow[p].end());
+        }
+        std::sort(spilled.begin(), spilled.end(), [&](size_type a, size_type b) {
+            return hashes[a] < hashes[b] || (hashes[a] == hashes[b] && a < b);
+        });
+        _displacements.resize(first_bucket);
+        std::vector<size_type> source(n);
+        parallel_for(parts, count > 1 ? count : 1, [&](size_type lo, size_type hi) {
+            for(size_type p = lo; p < hi; p++) {
+                const partition& part = _partitions[p];
+                std::copy(displacements[p].begin(), displacements[p].end(),
+                        _displacements.begin() + part.first_bucket);
+                std::copy(placed[p].begin(), placed[p].end(),
+                        source.begin() + part.first);
+            }
+        });
+        std::copy(spilled.begin(), spilled.end(), source.begin() + first);
+        _overflow.resize(spilled.size());
+        for(size_type i = 0; i < spilled.size(); i++)
+            _overflow[i] = hashes[spilled[i]];
+
+        // Move every element to the slot the hash function assigned it.
+        std::vector<value_type> ordered(n);
+        parallel_for(n, threads, [&](size_type first, size_type last) {
+            for(size_type i = first; i < last; i++)
+                ordered[i] = std::move(_entries[source[i]]);
+        });
+        _entries.swap(ordered);
+
+        if(fingerprints) {
+            _fingerprints.resize(n);
+            parallel_for(n, threads, [&](size_type first, size_type last) {
+                for(size_type i = first; i < last; i++)
+                    _fingerprints[i] = fingerprint(hashes[source[i]]);
+            });
+        }
+    }
+
+    /*
+     * Builds the hash function of partition p over its count keys, 
+     * trying seeds until the displacement search succeeds. placed 
+     * receives the key of every slot of the partition and overflow the 
+     * keys whose hash equals that of an earlier key.
+     */
+    void build_partition(size_type p, const size_type* members, size_type count,
+            const std::vector<std::uint64_t>& hashes,
+            std::vector<std::uint32_t>& displacements, std::vector<size_type>& placed,
+            std::vector<size_type>& overflow)
+    {
+        partition& part = _partitions[p];
+        std::vector<size_type> kept;
+        for(std::uint64_t attempt = 0; ; ) {
+            part.size = count;
+            part.buckets = (count + BUCKET_SIZE - 1) / BUCKET_SIZE;
+            if(count == 0)
+                return;
+
+            // Odd, as bucket() multiplies by it.
+            part.seed = mix_hash(p * 0x9e3779b97f4a7c15ULL + attempt + 1) | 1;
+            size_type spilled = overflow.size();
+            if(place(part, members, hashes, displacements, placed, overflow))
+                return;
+            if(overflow.size() == spilled) {
+                attempt++;
+                continue;
+            }
+
+            // Equal hashes share a bucket under every seed, so they are 
+            // all found at once. Retry the same seed without them.
+            std::sort(overflow.begin(), overflow.end());
+            kept.clear();
+            for(size_type i = 0; i < count; i++) {
+                if(!std::binary_search(overflow.begin(), overflow.end(), members[i]))
+                    kept.push_back(members[i]);
+            }
+            members = kept.data();
+            count = kept.size();
+        }
+    }
+
+    /**
+     * Searches a displacement for every bucket of a partition, largest
+     * buckets first, such that all keys land on distinct slots.
+     *
+     * @return false if some bucket could not be placed with this seed 
+     * or keys with equal hashes were moved to overflow.
+     */
+    static bool place(const partition& part, const size_type* members,
+            const std::vector<std::uint64_t>& hashes,
+            std::vector<std::uint32_t>& displacements, std::vector<size_type>& placed,
+            std::vector<size_type>& overflow)
+    {
+        size_type n = part.size;
+        size_type buckets = part.buckets;
+
+        std::vector<std::uint32_t> bucket_of(n);
+        for(size_type i = 0; i < n; i++)
+            bucket_of[i] = bucket(part, hashes[members[i]]);
+        std::vector<size_type> keys;
+        std::vector<size_type> start;
+        group_by(bucket_of, buckets, keys, start);
+
+        // Order the buckets by decreasing size.
+        size_type largest = 0;
+        for(size_type b = 0; b < buckets; b++)
+            largest = std::max(largest, start[b + 1] - start[b]);
+        std::vector<std::vector<size_type>> by_size(largest + 1);
+        for(size_type b = 0; b < buckets; b++)
+            by_size[start[b + 1] - start[b]].push_back(b);
+
+        displacements.assign(buckets, 0);
+        placed.assign(n, 0);
+        std::vector<bool> taken(n, false);
+        std::vector<size_type> slots;
+        size_type next_free = 0;
+        size_type spilled = overflow.size();
+        for(size_type s = largest; s > 0; s--) {
+            for(size_type b : by_size[s]) {
+                const size_type* first = &keys[start[b]];
+                if(s == 1) {
+                    if(overflow.size() != spilled)
+                        return false;
+                    while(taken[next_free])
+                        next_free++;
+                    taken[next_free] = true;
+                    placed[next_free] = members[first[0]];
+                    displacements[b] = DIRECT | next_free;
+                    continue;
+                }
+
+                // Keys keep their input order within a bucket, so the 
+                // first of several keys with equal hashes stays. Once one 
+                // is found the remaining buckets are only searched for more.
+                for(size_type i = 1; i < s; i++) {
+                    for(size_type j = 0; j < i; j++) {
+                        if(hashes[members[first[i]]] == hashes[members[first[j]]]) {
+                            overflow.push_back(members[first[i]]);
+                            break;
+                        }
+                    }
+                }
+                if(overflow.size() != spilled)
+                    continue;
+
+                std::uint32_t d = 0;
+                for(; d < MAX_DISPLACEMENT; d++) {
+                    slots.clear();
+                    bool ok = true;
+                    for(size_type i = 0; i < s && ok; i++) {
+                        size_type j = slot(part, hashes[members[first[i]]], d);
+                        ok = !taken[j];
+                        for(size_type k : slots)
+                            ok = ok && k != j;
+                        slots.push_back(j);
+                    }
+                    if(ok)
+                        break;
+                }
+                if(d == MAX_DISPLACEMENT)
+                    return false;
+
+                displacements[b] = d;
+                for(size_type i = 0; i < s; i++) {
+                    taken[slots[i]] = true;
+                    placed[slots[i]] = members[first[i]];
+                }
+            }
+        }
+        return overflow.size() == spilled;
+    }
+};
+
+}
+
+#endif /* FROZENMAP_H */
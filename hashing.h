@@ -0,0 +1,48 @@
+/*
+ * File:   hashing.h
+ */
+
+#ifndef HASHING_H
+#define HASHING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <random>
+
+namespace ljl {
+
+/**
+ * Scrambles all bits of a hash value (the 64 bit finalizer of MurmurHash3).
+ * std::hash is the identity for integral types on most implementations,
+ * so anything that derives more than a bucket index from a hash should
+ * mix it first.
+ *
+ * @param h - hash value to mix
+ * @return The mixed hash value.
+ */
+inline std::uint64_t mix_hash(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Returns a fresh random seed for hashing. Only the first call reads 
+ * from std::random_device, later seeds are derived from it.
+ * 
+ * @return A random seed.
+ */
+inline std::uint64_t random_seed() {
+    static std::atomic<std::uint64_t> state(
+            (std::uint64_t)std::random_device{}() << 32 | std::random_device{}());
+    return mix_hash(state.fetch_add(0x9e3779b97f4a7c15ULL));
+}
+
+}
+
+#endif /* HASHING_H */
+
@@ -9,7 +9,7 @@
 #define ITERATOR_H
 
 #include <iterator>
-#include <type_traits>  // remove_cv
+#include <type_traits>  // remove_cv, conditional
 
 #include "container.h"
 #include "arraymap.h"
@@ -21,7 +21,13 @@ template<
     typename UnqualifiedT = typename std::remove_cv<T>::type
 >
 class arraymap_iterator {
-    template<typename K, typename V> friend class array_map;
+    template<typename K, typename V, typename P> friend class array_map;
+    template<typename U, typename UnqualifiedU> friend class arraymap_iterator;
+    
+    using container_type = typename std::conditional<
+        std::is_const<T>::value, 
+        const smart_container<UnqualifiedT>, 
+        smart_container<UnqualifiedT>>::type;
     
 public:
     using value_type = T;
@@ -36,13 +42,13 @@ public:
         _current = other._current;
     }
     
-    arraymap_iterator(smart_container<UnqualifiedT>* container) {
+    arraymap_iterator(container_type* container) {
         _values = container;
         _current = 0;
-        next_element();
+        skip_free();
     }
     
-    arraymap_iterator(smart_container<UnqualifiedT>* container, unsigned int i) 
+    arraymap_iterator(container_type* container, unsigned int i) 
     { 
         _values = container;
         _current = i;
@@ -59,8 +65,8 @@ public:
         return (*_values)[_current];
     }
     
-    reference operator->() const {
-        return (*this);
+    pointer operator->() const {
+        return &(*_values)[_current];
     }
 
     arraymap_iterator& operator++() {
@@ -89,14 +95,16 @@ public:
     }
     
 private:
-    smart_container<UnqualifiedT>* _values;
+    container_type* _values;
     unsigned int _current;
     
     void next_element() {
-        while(++_current < _values->capacity()) {
-            if(!_values->free(_current))
-                break;
-        }
+        ++_current;
+        skip_free();
+    }
+    void skip_free() {
+        while(_current < _values->capacity() && _values->free(_current))
+            ++_current;
     }
 };
 
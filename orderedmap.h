@@ -0,0 +1,499 @@
+/*
+ * File:   orderedmap.h
+ */
+
+#ifndef ORDEREDMAP_H
+#define ORDEREDMAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <functional>
+#include "hashing.h"
+#include "probing.h"
+
+namespace ljl {
+
+/**
+ * Map that iterates in insertion order, laid out like a compact dict.
+ * The elements live densely in an entries vector in the order they were
+ * inserted; the open address slot array only holds indices into it,
+ * 8, 16, 32 or 64 bits wide depending on the capacity. Empty slots
+ * therefore cost a few bytes, and iteration is a linear scan over the
+ * entries instead of the slot array. Erasing leaves a hole in the
+ * entries that is squeezed out when the slot array is next rebuilt;
+ * the order of the remaining elements never changes.
+ */
+template<typename K, typename V, typename Probe = linear_probe>
+class ordered_map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using hasher = std::hash<K>;
+
+private:
+    struct entry {
+        value_type value;
+        size_type hash;
+        bool live;
+    };
+
+public:
+    /**
+     * Forward iterator over the elements in insertion order.
+     */
+    template<typename Entry, typename Value>
+    class basic_iterator {
+        friend class ordered_map;
+    public:
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator() = default;
+        basic_iterator(Entry* current, Entry* last) : _current(current), _last(last) {
+            skip_erased();
+        }
+
+        reference operator*() const {
+            return _current->value;
+        }
+        pointer operator->() const {
+            return &_current->value;
+        }
+
+        basic_iterator& operator++() {
+            ++_current;
+            skip_erased();
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        bool operator==(const basic_iterator& rhs) const {
+            return _current == rhs._current;
+        }
+        bool operator!=(const basic_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+
+        operator basic_iterator<const Entry, const Value>() const {
+            return basic_iterator<const Entry, const Value>(_current, _last);
+        }
+
+    private:
+        Entry* _current;
+        Entry* _last;
+
+        void skip_erased() {
+            while(_current != _last && !_current->live)
+                ++_current;
+        }
+    };
+
+    using iterator = basic_iterator<entry, value_type>;
+    using const_iterator = basic_iterator<const entry, const value_type>;
+
+    /**
+     * Initializes the container with a capacity of 8 and a
+     * max_load_factor of 0.70f.
+     */
+    ordered_map() {
+        _maxLoad = 0.70f;
+        _size = 0;
+        _seed = random_seed();
+        build_index(Probe::capacity(DEFAULT_CAPACITY));
+    }
+
+    /**
+     * Checks if the container has no elements
+     *
+     * @return true if the container is empty, false otherwise
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+    /**
+     * Returns the number of elements in the container
+     *
+     * @return The number of elements in the container.
+     */
+    size_type size() const {
+        return _size;
+    }
+    /**
+     * Return the capacity of the slot array
+     *
+     * @return The capacity of the container.
+     */
+    size_type capacity() const {
+        return _capacity;
+    }
+    /**
+     * Removes all elements from the container.
+     */
+    void clear() {
+        std::vector<entry>().swap(_entries);
+        _size = 0;
+        build_index(Probe::capacity(DEFAULT_CAPACITY));
+    }
+
+    /**
+     * Inserts a new element at the end of the order, unless an
+     * element with key key exists already.
+     *
+     * @param key - element key to emplace
+     * @param value - element value to emplace
+     * @return Returns a pair consisting of an iterator to the
+     * inserted element, or the already-existing element if no
+     * insertion happened, and a bool denoting whether the
+     * insertion took place.
+     */
+    std::pair<iterator, bool> emplace(const key_type& key, const mapped_type& value) {
+        size_type h = hasher{}(key);
+        size_type e = find_entry(key, h);
+        if(e != NONE)
+            return std::make_pair(make_iterator(e), false);
+
+        e = insert_new(value_type(key, value), h);
+        return std::make_pair(make_iterator(e), true);
+    }
+
+    /**
+     * Returns a reference to the value that is mapped to a
+     * key equivalent to key, performing an insertion at the end of
+     * the order if such key does not already exist.
+     *
+     * @param key - the key of the element to find
+     * @return Reference to the mapped value of the element with key key.
+     */
+    V& operator[](const K& key) {
+        size_type h = hasher{}(key);
+        size_type e = find_entry(key, h);
+        if(e == NONE)
+            e = insert_new(value_type(key, mapped_type()), h);
+        return _entries[e].value.second;
+    }
+
+    /**
+     * Returns a reference to the mapped value of the element
+     * with a key equivalent to key. If no such element exists,
+     * an exception of type std::out_of_range is thrown.
+     *
+     * @param key - the key of the element to find
+     * @return Reference to the mapped value of the requested element
+     */
+    V& at(const K& key) {
+        return const_cast<V&>(static_cast<const ordered_map&>(*this).at(key));
+    }
+    const V& at(const K& key) const {
+        size_type e = find_entry(key, hasher{}(key));
+        if(e == NONE)
+            throw std::out_of_range("Key not found");
+        return _entries[e].value.second;
+    }
+
+    /**
+     * Finds an element with key equivalent to key.
+     *
+     * @param key - key value of the element to search for
+     * @return Iterator to the element, or end() if there is none.
+     */
+    iterator find(const K& key) {
+        size_type e = find_entry(key, hasher{}(key));
+        return e == NONE ? end() : make_iterator(e);
+    }
+    const_iterator find(const K& key) const {
+        size_type e = find_entry(key, hasher{}(key));
+        return e == NONE ? end() : const_iterator(&_entries[e], last());
+    }
+
+    /**
+     * Returns the number of elements with key key, which is either 1
+     * or 0.
+     *
+     * @param key - key value of the elements to count
+     * @return Number of elements with key key, that is
+     * either 1 or 0.
+     */
+    size_type count(const K& key) const {
+        return find_entry(key, hasher{}(key)) == NONE ? 0 : 1;
+    }
+
+    /**
+     * Removes the element (if one exists) with the key
+     * equivalent to key. The order of the other elements is kept.
+     *
+     * @param key - key value of the elements to remove
+     * @return Number of elements removed.
+     */
+    size_type erase(const key_type& key) {
+        size_type h = hasher{}(key);
+        Probe probe = start(h);
+        for(; slot(probe.index()) != EMPTY; probe.next()) {
+            size_type e = slot(probe.index());
+            if(e == ERASED || !matches(e, key, h))
+                continue;
+
+            set_slot(probe.index(), ERASED);
+            _entries[e].live = false;
+            _entries[e].value = value_type();
+            _size--;
+            return 1;
+        }
+        return 0;
+    }
+
+    /**
+     * Returns the ratio between elements in the container
+     * and the capacity of the slot array.
+     *
+     * @return The load factor of the container.
+     */
+    float load_factor() const {
+        return (float)size() / (float)capacity();
+    }
+    /**
+     * @return The maximum load factor of the container.
+     */
+    float max_load_factor() const {
+        return _maxLoad;
+    }
+    /**
+     * Sets the maximum load factor, rebuilding the slot array if
+     * the entries do not fit anymore.
+     *
+     * @param ml - new maximum load factor setting
+     */
+    void max_load_factor(float ml) {
+        _maxLoad = ml;
+        if(_entries.size() >= usable())
+            rebuild(grown_capacity());
+    }
+
+    /**
+     * Makes room for count elements without rebuilding the slot
+     * array.
+     *
+     * @param count - new capacity of the container
+     */
+    void reserve(size_type count) {
+        size_type slots = std::ceil(count / max_load_factor()) + 1;
+        if(slots > capacity())
+            rebuild(Probe::capacity(slots));
+        _entries.reserve(count);
+    }
+
+    /**
+     * @return Number of bytes taken by the slot array.
+     */
+    size_type index_bytes() const {
+        return _index.size();
+    }
+
+    iterator begin() {
+        return iterator(_entries.data(), last());
+    }
+    const_iterator begin() const {
+        return const_iterator(_entries.data(), last());
+    }
+    const_iterator cbegin() const {
+        return begin();
+    }
+    iterator end() {
+        return iterator(last(), last());
+    }
+    const_iterator end() const {
+        return const_iterator(last(), last());
+    }
+    const_iterator cend() const {
+        return end();
+    }
+
+private:
+    static const size_type DEFAULT_CAPACITY = 8;
+    // Slot values; stored as the two largest values of the slot width.
+    static const size_type EMPTY = ~(size_type)0;
+    static const size_type ERASED = ~(size_type)0 - 1;
+    static const size_type NONE = ~(size_type)0;
+
+    float _maxLoad;
+    size_type _size;
+    size_type _seed;
+    size_type _capacity;
+    // Bytes per slot of _index.
+    size_type _width;
+    std::vector<unsigned char> _index;
+    std::vector<entry> _entries;
+
+    entry* last() {
+        return _entries.data() + _entries.size();
+    }
+    const entry* last() const {
+        return _entries.data() + _entries.size();
+    }
+    iterator make_iterator(size_type e) {
+        return iterator(&_entries[e], last());
+    }
+
+    // Erased entries keep their slots until the next rebuild.
+    size_type usable() const {
+        return _capacity * _maxLoad;
+    }
+    size_type grown_capacity() const {
+        size_type slots = std::ceil(2 * size() / max_load_factor()) + 1;
+        return Probe::capacity(std::max(slots, DEFAULT_CAPACITY));
+    }
+
+    static size_type slot_width(size_type capacity) {
+        if(capacity < 0xff)
+            return 1;
+        if(capacity < 0xffff)
+            return 2;
+        if(capacity < 0xffffffff)
+            return 4;
+        return 8;
+    }
+
+    template<typename T>
+    static size_type widen(T value) {
+        if(value == (T)EMPTY)
+            return EMPTY;
+        if(value == (T)ERASED)
+            return ERASED;
+        return value;
+    }
+
+    size_type slot(size_type i) const {
+        const unsigned char* at = &_index[i * _width];
+        switch(_width) {
+        case 1: {
+            return widen(*at);
+        }
+        case 2: {
+            std::uint16_t value;
+            std::memcpy(&value, at, sizeof(value));
+            return widen(value);
+        }
+        case 4: {
+            std::uint32_t value;
+            std::memcpy(&value, at, sizeof(value));
+            return widen(value);
+        }
+        default: {
+            std::uint64_t value;
+            std::memcpy(&value, at, sizeof(value));
+            return widen(value);
+        }
+        }
+    }
+
+    void set_slot(size_type i, size_type e) {
+        unsigned char* at = &_index[i * _width];
+        switch(_width) {
+        case 1: {
+            *at = (unsigned char)e;
+            break;
+        }
+        case 2: {
+            std::uint16_t value = (std::uint16_t)e;
+            std::memcpy(at, &value, sizeof(value));
+            break;
+        }
+        case 4: {
+            std::uint32_t value = (std::uint32_t)e;
+            std::memcpy(at, &value, sizeof(value));
+            break;
+        }
+        default: {
+            std::uint64_t value = e;
+            std::memcpy(at, &value, sizeof(value));
+            break;
+        }
+        }
+    }
+
+    Probe start(size_type h) const {
+        return Probe(mix_hash(h ^ _seed), _capacity);
+    }
+
+    bool matches(size_type e, const key_type& key, size_type h) const {
+        return _entries[e].hash == h && _entries[e].value.first == key;
+    }
+
+    size_type find_entry(const key_type& key, size_type h) const {
+        for(Probe probe = start(h); slot(probe.index()) != EMPTY; probe.next()) {
+            size_type e = slot(probe.index());
+            if(e != ERASED && matches(e, key, h))
+                return e;
+        }
+        return NONE;
+    }
+
+    void build_index(size_type capacity) {
+        _capacity = capacity;
+        _width = slot_width(capacity);
+        // All bits set is EMPTY in every width.
+        _index.assign(capacity * _width, 0xff);
+    }
+
+    void place(size_type e) {
+        Probe probe = start(_entries[e].hash);
+        while(slot(probe.index()) != EMPTY)
+            probe.next();
+        set_slot(probe.index(), e);
+    }
+
+    /*
+     * Squeezes erased entries out of the entries vector, keeping the
+     * order, and builds a slot array of the given capacity for them.
+     */
+    void rebuild(size_type capacity) {
+        _entries.erase(std::remove_if(_entries.begin(), _entries.end(),
+                [](const entry& e) { return !e.live; }), _entries.end());
+        build_index(capacity);
+        for(size_type e = 0; e < _entries.size(); e++)
+            place(e);
+    }
+
+    size_type insert_new(value_type&& value, size_type h) {
+        if(_entries.size() + 1 > usable())
+            rebuild(grown_capacity());
+
+        _entries.push_back(entry{std::move(value), h, true});
+        _size++;
+        place(_entries.size() - 1);
+        return _entries.size() - 1;
+    }
+};
+
+template<typename K, typename V, typename Probe>
+const typename ordered_map<K, V, Probe>::size_type
+        ordered_map<K, V, Probe>::DEFAULT_CAPACITY;
+template<typename K, typename V, typename Probe>
+const typename ordered_map<K, V, Probe>::size_type
+        ordered_map<K, V, Probe>::EMPTY;
+template<typename K, typename V, typename Probe>
+const typename ordered_map<K, V, Probe>::size_type
+        ordered_map<K, V, Probe>::ERASED;
+template<typename K, typename V, typename Probe>
+const typename ordered_map<K, V, Probe>::size_type
+        ordered_map<K, V, Probe>::NONE;
+
+}
+
+#endif /* ORDEREDMAP_H */
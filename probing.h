@@ -0,0 +1,118 @@
+/*
+ * File:   probing.h
+ */
+
+#ifndef PROBING_H
+#define PROBING_H
+
+#include <cstddef>
+
+namespace ljl {
+
+/*
+ * Probe sequence policies for array_map. A policy is constructed from
+ * the mixed hash of a key and the capacity of the slot array; index()
+ * is the slot to look at and next() moves to the following one. Every
+ * sequence visits all slots of a capacity returned by capacity(), so
+ * a probe always ends at an empty slot.
+ */
+
+/**
+ * Probes consecutive slots. Best cache locality, but keys that land
+ * close together form long runs (primary clustering).
+ */
+class linear_probe {
+public:
+    static size_t capacity(size_t requested) {
+        return requested;
+    }
+
+    linear_probe(size_t hash, size_t capacity) {
+        _i = hash % capacity;
+        _capacity = capacity;
+    }
+
+    size_t index() const {
+        return _i;
+    }
+    void next() {
+        _i = (_i == _capacity-1) ? 0 : _i + 1;
+    }
+
+private:
+    size_t _i;
+    size_t _capacity;
+};
+
+/**
+ * Probes at triangular number offsets (1, 3, 6, 10, ...) from the home
+ * slot, which avoids primary clustering while the first few probes
+ * still share cache lines. Capacities are powers of two.
+ */
+class quadratic_probe {
+public:
+    static size_t capacity(size_t requested) {
+        return round_up(requested);
+    }
+
+    quadratic_probe(size_t hash, size_t capacity) {
+        _mask = capacity - 1;
+        _i = hash & _mask;
+        _step = 0;
+    }
+
+    size_t index() const {
+        return _i;
+    }
+    void next() {
+        _step++;
+        _i = (_i + _step) & _mask;
+    }
+
+    static size_t round_up(size_t requested) {
+        size_t capacity = 1;
+        while(capacity < requested)
+            capacity <<= 1;
+        return capacity;
+    }
+
+private:
+    size_t _i;
+    size_t _mask;
+    size_t _step;
+};
+
+/**
+ * Probes with a step taken from the high bits of the hash, so keys
+ * sharing a home slot follow different sequences (no secondary
+ * clustering either), at the cost of a cache miss per probe.
+ * Capacities are powers of two and steps are odd.
+ */
+class double_hash_probe {
+public:
+    static size_t capacity(size_t requested) {
+        return quadratic_probe::round_up(requested);
+    }
+
+    double_hash_probe(size_t hash, size_t capacity) {
+        _mask = capacity - 1;
+        _i = hash & _mask;
+        _step = (hash >> (sizeof(size_t) * 4)) | 1;
+    }
+
+    size_t index() const {
+        return _i;
+    }
+    void next() {
+        _i = (_i + _step) & _mask;
+    }
+
+private:
+    size_t _i;
+    size_t _mask;
+    size_t _step;
+};
+
+}
+
+#endif /* PROBING_H */
@@ -0,0 +1,351 @@
+/*
+ * File:   slabmap.h
+ */
+
+#ifndef SLABMAP_H
+#define SLABMAP_H
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include <iterator>
+#include "arraymap.h"
+
+namespace ljl {
+
+/**
+ * Map for wide mapped types. The slot array of the underlying
+ * array_map only holds keys and 32 bit handles, the values live densely
+ * in a separate slab. Probes and iteration therefore only touch keys,
+ * empty slots cost a handle instead of a whole value, and a rehash
+ * moves keys and handles but never a value. Slab entries of erased
+ * elements are reused by later insertions; shrink_to_fit compacts the
+ * slab. Pointers and references to values stay valid until the slab
+ * has to grow.
+ */
+template<typename K, typename V>
+class slab_map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using size_type = size_t;
+    using handle_type = std::uint32_t;
+    using index_type = array_map<K, handle_type>;
+
+    /**
+     * Forward iterator over the elements. Dereferencing yields a pair
+     * of references to the key and to the mapped value. Iterators 
+     * only read the index, so copies of the map keep sharing its pages.
+     */
+    template<typename IndexIterator, typename Value>
+    class basic_iterator {
+        friend class slab_map;
+    public:
+        using value_type = std::pair<const K&, Value&>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+        using iterator_category = std::forward_iterator_tag;
+
+        // Holds the pair returned by operator-> for the duration of the call.
+        struct pointer {
+            value_type element;
+            const value_type* operator->() const {
+                return &element;
+            }
+        };
+
+        basic_iterator() = default;
+        basic_iterator(IndexIterator it, Value* slab) : _it(it), _slab(slab) {}
+
+        reference operator*() const {
+            return value_type(_it->first, _slab[_it->second]);
+        }
+        pointer operator->() const {
+            return pointer{**this};
+        }
+
+        basic_iterator& operator++() {
+            ++_it;
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator temp = *this;
+            ++_it;
+            return temp;
+        }
+
+        bool operator==(const basic_iterator& rhs) const {
+            return _it == rhs._it;
+        }
+        bool operator!=(const basic_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+
+        operator basic_iterator<IndexIterator, const V>() const {
+            return basic_iterator<IndexIterator, const V>(_it, _slab);
+        }
+
+    private:
+        IndexIterator _it;
+        Value* _slab;
+    };
+
+    using iterator = basic_iterator<typename index_type::const_iterator, V>;
+    using const_iterator = basic_iterator<typename index_type::const_iterator, const V>;
+
+    /**
+     * Initializes an empty container, see array_map().
+     */
+    slab_map() {}
+    /**
+     * Initializes an empty container whose slot array is allocated
+     * according to policy. The slab is allocated from the heap.
+     *
+     * @param policy - how to allocate the slot array
+     */
+    explicit slab_map(const allocation_policy& policy) : _index(policy) {}
+
+    /**
+     * Checks if the container has no elements
+     *
+     * @return true if the container is empty, false otherwise
+     */
+    bool empty() const {
+        return _index.empty();
+    }
+    /**
+     * Returns the number of elements in the container
+     *
+     * @return The number of elements in the container.
+     */
+    size_type size() const {
+        return _index.size();
+    }
+    /**
+     * Return the capacity of the slot array
+     *
+     * @return The capacity of the container.
+     */
+    size_type capacity() const {
+        return _index.capacity();
+    }
+    /**
+     * Removes all elements from the container and releases the slab.
+     */
+    void clear() {
+        _index.clear();
+        std::vector<V>().swap(_slab);
+        _free.clear();
+    }
+
+    /**
+     * Inserts a new element into the container.
+     *
+     * @param key - element key to emplace
+     * @param value - element value to emplace
+     * @return Returns a pair consisting of an iterator to the
+     * inserted element, or the already-existing element if no
+     * insertion happened, and a bool denoting whether the
+     * insertion took place.
+     */
+    std::pair<iterator, bool> emplace(const key_type& key, const mapped_type& value) {
+        std::pair<typename index_type::iterator, bool> result = insert_key(key, value);
+        return std::make_pair(iterator(result.first, _slab.data()), result.second);
+    }
+
+    /**
+     * Returns a reference to the value that is mapped to a
+     * key equivalent to key, performing an insertion if such
+     * key does not already exist.
+     *
+     * @param key - the key of the element to find
+     * @return Reference to the mapped value of the element with key key.
+     */
+    V& operator[](const K& key) {
+        return _slab[insert_key(key, mapped_type()).first->second];
+    }
+
+    /**
+     * Returns a reference to the mapped value of the element
+     * with a key equivalent to key. If no such element exists,
+     * an exception of type std::out_of_range is thrown.
+     *
+     * @param key - the key of the element to find
+     * @return Reference to the mapped value of the requested element
+     */
+    V& at(const K& key) {
+        return _slab[index().at(key)];
+    }
+    const V& at(const K& key) const {
+        return _slab[_index.at(key)];
+    }
+
+    /**
+     * Finds an element with key equivalent to key.
+     *
+     * @param key - key value of the element to search for
+     * @return Iterator to the element, or end() if there is none.
+     */
+    iterator find(const K& key) {
+        return iterator(index().find(key), _slab.data());
+    }
+    const_iterator find(const K& key) const {
+        return const_iterator(_index.find(key), _slab.data());
+    }
+
+    /**
+     * Returns the number of elements with key key, which is either 1
+     * or 0.
+     *
+     * @param key - key value of the elements to count
+     * @return Number of elements with key key, that is
+     * either 1 or 0.
+     */
+    size_type count(const K& key) const {
+        return _index.count(key);
+    }
+
+    /**
+     * Removes the element (if one exists) with the key
+     * equivalent to key. Its slab entry is reset and reused by a
+     * later insertion.
+     *
+     * @param key - key value of the elements to remove
+     * @return Number of elements removed.
+     */
+    size_type erase(const key_type& key) {
+        typename index_type::iterator it = _index.find(key);
+        if(it == _index.end())
+            return 0;
+
+        handle_type handle = it->second;
+        _index.erase(it);
+        _slab[handle] = mapped_type();
+        _free.push_back(handle);
+        return 1;
+    }
+
+    /**
+     * @return The load factor of the slot array.
+     */
+    float load_factor() const {
+        return _index.load_factor();
+    }
+    /**
+     * @return The maximum load factor of the slot array.
+     */
+    float max_load_factor() const {
+        return _index.max_load_factor();
+    }
+    /**
+     * @param ml - new maximum load factor setting
+     */
+    void max_load_factor(float ml) {
+        _index.max_load_factor(ml);
+    }
+
+    /**
+     * Makes room for count elements in the slot array and the slab.
+     *
+     * @param count - new capacity of the container
+     */
+    void reserve(size_type count) {
+        _index.reserve(count);
+        _slab.reserve(count);
+    }
+
+    /**
+     * Shrinks the slot array like array_map::shrink_to_fit and moves
+     * the values into a slab without unused entries.
+     */
+    void shrink_to_fit() {
+        _index.shrink_to_fit();
+
+        std::vector<V> slab;
+        slab.reserve(size());
+        for(auto& element : _index) {
+            slab.push_back(std::move(_slab[element.second]));
+            element.second = static_cast<handle_type>(slab.size() - 1);
+        }
+        _slab.swap(slab);
+        _free.clear();
+    }
+
+    /**
+     * @return Number of entries in the slab, including unused ones.
+     */
+    size_type slab_size() const {
+        return _slab.size();
+    }
+
+    iterator begin() {
+        return iterator(index().begin(), _slab.data());
+    }
+    const_iterator begin() const {
+        return const_iterator(_index.begin(), _slab.data());
+    }
+    const_iterator cbegin() const {
+        return begin();
+    }
+    iterator end() {
+        return iterator(index().end(), _slab.data());
+    }
+    const_iterator end() const {
+        return const_iterator(_index.end(), _slab.data());
+    }
+    const_iterator cend() const {
+        return end();
+    }
+
+private:
+    index_type _index;
+    std::vector<V> _slab;
+    // Slab entries of erased elements.
+    std::vector<handle_type> _free;
+    
+    // Read access to the index that never copies a shared page.
+    const index_type& index() const {
+        return _index;
+    }
+
+    /*
+     * Looks key up with a single hash and probe, inserting it with a 
+     * new slab entry holding value if it is missing.
+     */
+    std::pair<typename index_type::iterator, bool> insert_key(
+            const key_type& key, const mapped_type& value) 
+    {
+        std::pair<typename index_type::iterator, bool> result = 
+                _index.emplace_hashed(key, 0, _index.hash_function()(key));
+        if(!result.second)
+            return result;
+
+        try {
+            result.first->second = allocate(value);
+        } catch(...) {
+            _index.erase(result.first);
+            throw;
+        }
+        return result;
+    }
+
+    handle_type allocate(const mapped_type& value) {
+        if(!_free.empty()) {
+            handle_type handle = _free.back();
+            _free.pop_back();
+            _slab[handle] = value;
+            return handle;
+        }
+        if(_slab.size() > std::numeric_limits<handle_type>::max())
+            throw std::length_error("slab_map: too many elements");
+
+        _slab.push_back(value);
+        return static_cast<handle_type>(_slab.size() - 1);
+    }
+};
+
+}
+
+#endif /* SLABMAP_H */
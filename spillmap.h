@@ -0,0 +1,678 @@
+/*
+ * File:   spillmap.h
+ */
+
+#ifndef SPILLMAP_H
+#define SPILLMAP_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <functional>
+#include <future>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#else
+#include <mutex>
+#endif
+#include "arraycache.h"
+#include "hashing.h"
+
+namespace ljl {
+
+/**
+ * Map for tables that outgrow memory. Recently used elements live in a
+ * hot tier, an array_cache of fixed capacity. When it is full the CLOCK
+ * algorithm picks a batch of elements to evict; those that changed are
+ * written to a new segment file on disk, sorted by hash in pages of
+ * PAGE_SIZE bytes. For every segment only the first hash of each page
+ * and a 16 bit fingerprint per element stay in memory, so a lookup that
+ * misses the hot tier only reads pages whose fingerprints match, which
+ * for a present key is normally a single page. Erased keys are spilled
+ * as tombstones. Segments are merged in size tiers: new segments are on
+ * level 0, and once a level holds LEVEL_SEGMENTS segments they are
+ * merged into one segment on the next level, dropping overwritten
+ * elements. Every element is thus rewritten once per level, a number
+ * that grows logarithmically with the data. Tombstones are dropped
+ * when a merge includes the oldest segment.
+ *
+ * Keys and values are written to disk as bytes and must therefore be
+ * trivially copyable. Keys that point to other memory, like long
+ * string_keys, need that memory to outlive the map.
+ */
+template<typename K, typename V>
+class spill_map {
+    static_assert(std::is_trivially_copyable<K>::value
+            && std::is_trivially_copyable<V>::value,
+            "spill_map stores keys and values on disk as bytes");
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using size_type = size_t;
+
+    static const size_type PAGE_SIZE = 4096;
+    static const size_type LEVEL_SEGMENTS = 4;
+
+    /**
+     * Initializes an empty map.
+     *
+     * @param hot_capacity - maximum number of elements kept in memory
+     * @param directory - existing directory to write segment files to,
+     * they are removed again when no longer needed
+     * @param batch - number of elements evicted from memory at once,
+     * 0 means a quarter of hot_capacity
+     */
+    spill_map(size_type hot_capacity, const std::string& directory,
+            size_type batch = 0)
+        : _hot(std::max<size_type>(hot_capacity, 1))
+    {
+        _batch = batch != 0 ? batch : std::max<size_type>(hot_capacity / 4, 1);
+        _prefix = directory + "/spill-" + std::to_string(random_seed());
+        _files = 0;
+        _pageReads = 0;
+        _recordsWritten = 0;
+    }
+    spill_map(const spill_map&) = delete;
+    spill_map& operator=(const spill_map&) = delete;
+
+    /**
+     * Inserts value for key, replacing the value if key exists
+     * already. Spills a batch of elements to disk if the hot tier is
+     * full.
+     *
+     * @param key - element key to insert
+     * @param value - element value to insert
+     */
+    void insert_or_assign(const key_type& key, const mapped_type& value) {
+        put(key, hot_entry{value, true, true});
+    }
+
+    /**
+     * Finds the value of key. An element found on disk is brought
+     * back into the hot tier.
+     *
+     * @param key - the key of the element to find
+     * @return Pointer to the value, valid until the map is modified,
+     * or nullptr if there is no element with key key.
+     */
+    const V* find(const K& key) {
+        hot_entry* entry = _hot.find(key);
+        if(entry == nullptr) {
+            record found;
+            if(!find_cold(key, hash(key), found))
+                return nullptr;
+
+            put(key, hot_entry{found.value, found.live, false});
+            entry = _hot.find(key);
+        }
+        return entry->live ? &entry->value : nullptr;
+    }
+
+    /**
+     * Finds many keys at once. Keys that miss the hot tier are grouped
+     * by the page they need, so every page is read at most once per
+     * call. Elements found on disk are not brought into the hot tier,
+     * so bulk lookups do not displace the working set.
+     *
+     * @param keys - the keys to find
+     * @param found - callable as found(const K&, const V&), called for
+     * every key that has an element
+     * @return Number of keys found.
+     */
+    template<typename Found>
+    size_type find_many(const std::vector<K>& keys, Found found) {
+        size_type count = 0;
+        std::vector<size_type> pending;
+        std::vector<std::uint64_t> hashes(keys.size());
+        for(size_type i = 0; i < keys.size(); i++) {
+            hot_entry* entry = _hot.find(keys[i]);
+            if(entry == nullptr) {
+                hashes[i] = hash(keys[i]);
+                pending.push_back(i);
+            } else if(entry->live) {
+                found(keys[i], entry->value);
+                count++;
+            }
+        }
+
+        std::vector<record> cold(keys.size());
+        find_cold_many(keys, hashes, pending, cold, 1);
+        for(size_type i : pending) {
+            if(cold[i].live) {
+                found(keys[i], cold[i].value);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Same as find_many, but reads the pages from disk asynchronously.
+     * The hot tier is looked up before returning; the pages each 
+     * segment needs are then read by threads worker threads with 
+     * positioned reads, one segment after another from the newest. 
+     * The map must not be used until the future is ready.
+     *
+     * @param keys - the keys to find
+     * @param threads - number of threads reading pages, 0 means one
+     * per hardware thread
+     * @return Future of the keys found and their values.
+     */
+    std::future<std::vector<std::pair<K, V>>> find_many_async(
+            const std::vector<K>& keys, unsigned int threads = 0)
+    {
+        if(threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        std::vector<std::pair<K, V>> found;
+        std::vector<K> cold_keys;
+        std::vector<std::uint64_t> hashes;
+        for(const K& key : keys) {
+            hot_entry* entry = _hot.find(key);
+            if(entry == nullptr) {
+                cold_keys.push_back(key);
+                hashes.push_back(hash(key));
+            } else if(entry->live) {
+                found.push_back(std::make_pair(key, entry->value));
+            }
+        }
+
+        return std::async(std::launch::async, &spill_map::find_cold_async, this,
+                std::move(cold_keys), std::move(hashes), std::move(found), threads);
+    }
+
+    /**
+     * Returns the number of elements with key key, which is either 1
+     * or 0.
+     *
+     * @param key - key value of the elements to count
+     * @return Number of elements with key key, that is
+     * either 1 or 0.
+     */
+    size_type count(const K& key) {
+        return find(key) != nullptr ? 1 : 0;
+    }
+
+    /**
+     * Removes the element (if one exists) with the key
+     * equivalent to key.
+     *
+     * @param key - key value of the elements to remove
+     * @return Number of elements removed.
+     */
+    size_type erase(const key_type& key) {
+        hot_entry* entry = _hot.find(key);
+        if(entry != nullptr && !entry->live)
+            return 0;
+
+        // A clean hot element is the newest copy of one on disk.
+        bool on_disk = entry != nullptr && !entry->dirty;
+        if(!on_disk) {
+            record found;
+            on_disk = find_cold(key, hash(key), found) && found.live;
+        }
+        if(entry == nullptr && !on_disk)
+            return 0;
+
+        if(on_disk)
+            put(key, hot_entry{V(), false, true});
+        else
+            _hot.erase(key);
+        return 1;
+    }
+
+    /**
+     * @return Number of elements (and tombstones) in memory.
+     */
+    size_type hot_size() const {
+        return _hot.size();
+    }
+    /**
+     * @return Number of segment files on disk.
+     */
+    size_type segments() const {
+        return _segments.size();
+    }
+    /**
+     * @return Number of records written to segments, by spills and
+     * by merges.
+     */
+    size_type records_written() const {
+        return _recordsWritten;
+    }
+    /**
+     * @return Number of pages lookups read from disk.
+     */
+    size_type page_reads() const {
+        return _pageReads;
+    }
+
+private:
+    struct hot_entry {
+        V value;
+        bool live;
+        // Set when the element differs from its newest copy on disk.
+        bool dirty;
+    };
+
+    struct record {
+        std::uint64_t hash;
+        K key;
+        V value;
+        bool live;
+    };
+
+    static const size_type PAGE_RECORDS = PAGE_SIZE / sizeof(record);
+    static_assert(PAGE_RECORDS > 0, "spill_map elements must fit a page");
+
+    /*
+     * A sorted, immutable file of records. Records with the same hash
+     * are kept in one page unless they do not fit any page.
+     */
+    struct segment {
+        explicit segment(const std::string& path) : path(path), level(0) {
+            file = std::fopen(path.c_str(), "w+b");
+            if(file == nullptr)
+                throw std::runtime_error("spill_map: can not create " + path);
+            // Reads and writes are whole pages, buffering only copies them.
+            std::setvbuf(file, nullptr, _IONBF, 0);
+        }
+        segment(const segment&) = delete;
+        segment& operator=(const segment&) = delete;
+
+        ~segment() {
+            std::fclose(file);
+            std::remove(path.c_str());
+        }
+
+        void append(const record* run, size_type n) {
+            if(!pending.empty() && pending.size() + n > PAGE_RECORDS)
+                flush();
+            for(size_type i = 0; i < n; i++) {
+                if(pending.size() == PAGE_RECORDS)
+                    flush();
+                pending.push_back(run[i]);
+            }
+        }
+        void finish() {
+            if(!pending.empty())
+                flush();
+            pending.shrink_to_fit();
+        }
+
+        size_type pages() const {
+            return fences.size();
+        }
+        /*
+         * Returns the range of pages that can hold records with hash h.
+         * Only a run of records too long for one page spans pages.
+         */
+        std::pair<size_type, size_type> candidates(std::uint64_t h) const {
+            size_type p = std::lower_bound(fences.begin(), fences.end(), h)
+                    - fences.begin();
+            if(p == pages() || fences[p] != h)
+                return p == 0 ? std::make_pair(p, p) : std::make_pair(p - 1, p);
+
+            size_type last = p;
+            while(last < pages() && fences[last] == h)
+                last++;
+            return std::make_pair(p, last);
+        }
+        bool may_contain(size_type p, std::uint64_t h) const {
+            size_type end = p + 1 < pages() ? offsets[p + 1] : fingerprints.size();
+            return std::find(fingerprints.begin() + offsets[p],
+                    fingerprints.begin() + end, fingerprint(h))
+                    != fingerprints.begin() + end;
+        }
+        // Safe to call from several threads at once.
+        void read(size_type p, std::vector<record>& out) const {
+            size_type end = p + 1 < pages() ? offsets[p + 1] : fingerprints.size();
+            out.resize(end - offsets[p]);
+            size_type bytes = out.size() * sizeof(record);
+#if defined(__unix__) || defined(__APPLE__)
+            bool complete = ::pread(fileno(file), out.data(), bytes,
+                    (off_t)(p * PAGE_SIZE)) == (ssize_t)bytes;
+#else
+            std::lock_guard<std::mutex> lock(seek);
+            bool complete = std::fseek(file, (long)(p * PAGE_SIZE), SEEK_SET) == 0
+                    && std::fread(out.data(), 1, bytes, file) == bytes;
+#endif
+            if(!complete)
+                throw std::runtime_error("spill_map: can not read " + path);
+        }
+
+        std::string path;
+        // Number of merges the records went through.
+        size_type level;
+        std::FILE* file;
+        // First hash of every page.
+        std::vector<std::uint64_t> fences;
+        // Index of the first fingerprint of every page.
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint16_t> fingerprints;
+        // Records of the page being written.
+        std::vector<record> pending;
+#if !defined(__unix__) && !defined(__APPLE__)
+        // Serializes seeking and reading without pread.
+        mutable std::mutex seek;
+#endif
+
+    private:
+        void flush() {
+            fences.push_back(pending.front().hash);
+            offsets.push_back(fingerprints.size());
+            for(const record& element : pending)
+                fingerprints.push_back(fingerprint(element.hash));
+
+            std::vector<char> page(PAGE_SIZE, 0);
+            std::memcpy(page.data(), pending.data(), pending.size() * sizeof(record));
+            if(std::fwrite(page.data(), PAGE_SIZE, 1, file) != 1)
+                throw std::runtime_error("spill_map: can not write " + path);
+            pending.clear();
+        }
+    };
+
+    // Reads a segment page by page, used to merge segments.
+    struct cursor {
+        explicit cursor(segment* source) : source(source) {
+            load(0);
+        }
+
+        bool done() const {
+            return pos == records.size();
+        }
+        const record& current() const {
+            return records[pos];
+        }
+        void next() {
+            if(++pos == records.size())
+                load(page + 1);
+        }
+        void load(size_type p) {
+            page = p;
+            pos = 0;
+            records.clear();
+            if(p < source->pages())
+                source->read(p, records);
+        }
+
+        segment* source;
+        size_type page;
+        size_type pos;
+        std::vector<record> records;
+    };
+
+    array_cache<K, hot_entry> _hot;
+    std::vector<std::unique_ptr<segment>> _segments;
+    size_type _batch;
+    std::string _prefix;
+    size_type _files;
+    size_type _pageReads;
+    size_type _recordsWritten;
+
+    static std::uint64_t hash(const key_type& key) {
+        return mix_hash(std::hash<key_type>{}(key));
+    }
+    // Records in a page share their high hash bits, so use the low ones.
+    static std::uint16_t fingerprint(std::uint64_t h) {
+        return static_cast<std::uint16_t>(h);
+    }
+
+    static record make_record(const K& key, const hot_entry& entry) {
+        record element;
+        std::memset(&element, 0, sizeof(element));
+        element.hash = hash(key);
+        element.key = key;
+        element.value = entry.value;
+        element.live = entry.live;
+        return element;
+    }
+
+    void put(const key_type& key, const hot_entry& entry) {
+        if(_hot.count(key) == 0 && _hot.size() >= _hot.capacity())
+            spill();
+        _hot.insert_or_assign(key, entry);
+    }
+
+    std::unique_ptr<segment> create_segment() {
+        return std::unique_ptr<segment>(
+                new segment(_prefix + "-" + std::to_string(_files++) + ".seg"));
+    }
+
+    /*
+     * Evicts a batch from the hot tier and writes the elements that
+     * changed into a new segment.
+     */
+    void spill() {
+        std::vector<record> batch;
+        _hot.evict(_batch, [&](std::pair<K, hot_entry>&& element) {
+            if(element.second.dirty)
+                batch.push_back(make_record(element.first, element.second));
+        });
+        if(batch.empty())
+            return;
+
+        std::sort(batch.begin(), batch.end(),
+                [](const record& a, const record& b) { return a.hash < b.hash; });
+        std::unique_ptr<segment> spilled = create_segment();
+        for(size_type i = 0, j = 0; i < batch.size(); i = j) {
+            while(j < batch.size() && batch[j].hash == batch[i].hash)
+                j++;
+            spilled->append(&batch[i], j - i);
+        }
+        spilled->finish();
+        _segments.push_back(std::move(spilled));
+        _recordsWritten += batch.size();
+
+        compact();
+    }
+
+    /*
+     * Merges levels that are full into one segment on the next level, 
+     * starting with level 0. The segments of a level are contiguous 
+     * and the levels decrease towards the newest segment, so the 
+     * lowest level is always at the end.
+     */
+    void compact() {
+        while(true) {
+            size_type level = _segments.back()->level;
+            size_type first = _segments.size();
+            while(first > 0 && _segments[first - 1]->level == level)
+                first--;
+            if(_segments.size() - first < LEVEL_SEGMENTS)
+                return;
+
+            merge(first, level + 1);
+        }
+    }
+
+    /*
+     * Merges the segments from first on into one segment on the given
+     * level. Newer segments win. Tombstones are only dropped when the
+     * oldest segment takes part, otherwise they still hide older copies.
+     */
+    void merge(size_type first, size_type level) {
+        std::unique_ptr<segment> merged = create_segment();
+        merged->level = level;
+        bool oldest = first == 0;
+        std::vector<cursor> cursors;
+        for(size_type s = first; s < _segments.size(); s++)
+            cursors.push_back(cursor(_segments[s].get()));
+
+        std::vector<record> run;
+        while(true) {
+            bool any = false;
+            std::uint64_t h = 0;
+            for(const cursor& c : cursors) {
+                if(!c.done() && (!any || c.current().hash < h)) {
+                    h = c.current().hash;
+                    any = true;
+                }
+            }
+            if(!any)
+                break;
+
+            run.clear();
+            for(size_type s = cursors.size(); s-- > 0; ) {
+                cursor& c = cursors[s];
+                for(; !c.done() && c.current().hash == h; c.next()) {
+                    const record& element = c.current();
+                    bool newer = std::any_of(run.begin(), run.end(),
+                            [&](const record& r) { return r.key == element.key; });
+                    if(!newer)
+                        run.push_back(element);
+                }
+            }
+            if(oldest) {
+                run.erase(std::remove_if(run.begin(), run.end(),
+                        [](const record& r) { return !r.live; }), run.end());
+            }
+            if(!run.empty())
+                merged->append(run.data(), run.size());
+            _recordsWritten += run.size();
+        }
+        merged->finish();
+
+        _segments.erase(_segments.begin() + first, _segments.end());
+        _segments.push_back(std::move(merged));
+    }
+
+    std::vector<std::pair<K, V>> find_cold_async(std::vector<K> keys,
+            std::vector<std::uint64_t> hashes, std::vector<std::pair<K, V>> found,
+            unsigned int threads)
+    {
+        std::vector<size_type> pending(keys.size());
+        for(size_type i = 0; i < keys.size(); i++)
+            pending[i] = i;
+
+        std::vector<record> cold(keys.size());
+        find_cold_many(keys, hashes, pending, cold, threads);
+        for(size_type i : pending) {
+            if(cold[i].live)
+                found.push_back(std::make_pair(keys[i], cold[i].value));
+        }
+        return found;
+    }
+
+    /*
+     * Finds the newest copies of the pending keys on disk. Each segment
+     * is searched for the keys not found in newer ones, reading every
+     * page it needs once, spread over threads threads. Afterwards
+     * pending holds the keys found, with their records in cold.
+     */
+    void find_cold_many(const std::vector<K>& keys,
+            const std::vector<std::uint64_t>& hashes,
+            std::vector<size_type>& pending, std::vector<record>& cold,
+            unsigned int threads)
+    {
+        std::vector<size_type> missing(pending);
+        pending.clear();
+        std::vector<char> resolved(keys.size(), 0);
+        std::vector<std::pair<size_type, size_type>> reads;
+        std::vector<size_type> groups;
+        for(size_type s = _segments.size(); s-- > 0 && !missing.empty(); ) {
+            const segment& source = *_segments[s];
+            reads.clear();
+            for(size_type i : missing) {
+                std::pair<size_type, size_type> pages = source.candidates(hashes[i]);
+                for(size_type p = pages.first; p < pages.second; p++) {
+                    if(source.may_contain(p, hashes[i]))
+                        reads.push_back(std::make_pair(p, i));
+                }
+            }
+            std::sort(reads.begin(), reads.end());
+
+            // Reads of one page form a group, handled by one thread.
+            // A segment holds every key once, so only one group can
+            // resolve a key.
+            groups.clear();
+            for(size_type r = 0; r < reads.size(); r++) {
+                if(r == 0 || reads[r].first != reads[r-1].first)
+                    groups.push_back(r);
+            }
+            groups.push_back(reads.size());
+            size_type pages = groups.size() - 1;
+            size_type workers = std::min<size_type>(threads, pages);
+            run_parallel(workers, [&](size_type t) {
+                std::vector<record> page;
+                for(size_type g = t; g < pages; g += workers) {
+                    source.read(reads[groups[g]].first, page);
+                    for(size_type r = groups[g]; r < groups[g + 1]; r++) {
+                        size_type i = reads[r].second;
+                        for(const record& element : page) {
+                            if(element.hash == hashes[i] && element.key == keys[i]) {
+                                cold[i] = element;
+                                resolved[i] = 1;
+                                break;
+                            }
+                        }
+                    }
+                }
+            });
+            _pageReads += pages;
+
+            for(size_type i : missing) {
+                if(resolved[i])
+                    pending.push_back(i);
+            }
+            missing.erase(std::remove_if(missing.begin(), missing.end(),
+                    [&](size_type i) { return resolved[i] != 0; }), missing.end());
+        }
+    }
+
+    // Runs task(0) to task(count-1), each on its own thread but the first.
+    template<typename Task>
+    static void run_parallel(size_type count, Task task) {
+        std::vector<std::thread> workers;
+        for(size_type i = 1; i < count; i++)
+            workers.emplace_back(task, i);
+        if(count > 0)
+            task(0);
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+
+    /*
+     * Finds the newest copy of key on disk, which may be a tombstone.
+     */
+    bool find_cold(const K& key, std::uint64_t h, record& found) {
+        std::vector<record> page;
+        for(size_type s = _segments.size(); s-- > 0; ) {
+            segment& source = *_segments[s];
+            std::pair<size_type, size_type> pages = source.candidates(h);
+            for(size_type p = pages.first; p < pages.second; p++) {
+                if(!source.may_contain(p, h))
+                    continue;
+
+                source.read(p, page);
+                _pageReads++;
+                for(const record& element : page) {
+                    if(element.hash == h && element.key == key) {
+                        found = element;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+template<typename K, typename V>
+const typename spill_map<K, V>::size_type spill_map<K, V>::PAGE_SIZE;
+template<typename K, typename V>
+const typename spill_map<K, V>::size_type spill_map<K, V>::LEVEL_SEGMENTS;
+template<typename K, typename V>
+const typename spill_map<K, V>::size_type spill_map<K, V>::PAGE_RECORDS;
+
+}
+
+#endif /* SPILLMAP_H */
@@ -0,0 +1,191 @@
+/*
+ * File:   stringkey.h
+ */
+
+#ifndef STRINGKEY_H
+#define STRINGKEY_H
+
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "hashing.h"
+
+namespace ljl {
+
+/**
+ * Compact string key for array_map. Strings of up to 23 characters
+ * are stored inline in the key together with their length, so they
+ * need no allocation and compare with a single memcmp. Longer strings
+ * only hold a pointer to characters owned by someone else, normally a
+ * key_arena. The key is trivially copyable.
+ */
+class string_key {
+public:
+    static const size_t INLINE_CAPACITY = 23;
+
+    string_key() {
+        std::memset(_raw, 0, sizeof(_raw));
+    }
+
+    /**
+     * Creates a key for the given characters without copying long
+     * strings. Use it for lookups; the characters must outlive the
+     * key. Keys stored in a map should come from key_arena::intern.
+     *
+     * @param data - the characters of the key
+     * @param size - the number of characters
+     * @return The key for the characters.
+     */
+    static string_key view(const char* data, size_t size) {
+        string_key key;
+        if(size <= INLINE_CAPACITY) {
+            std::memcpy(key._raw, data, size);
+            key._raw[INLINE_CAPACITY] = static_cast<char>(size);
+        } else {
+            std::uint64_t length = size;
+            std::memcpy(key._raw, &data, sizeof(data));
+            std::memcpy(key._raw + 8, &length, sizeof(length));
+            key._raw[INLINE_CAPACITY] = LONG;
+        }
+        return key;
+    }
+    static string_key view(const std::string& str) {
+        return view(str.data(), str.size());
+    }
+
+    const char* data() const {
+        if(!is_long())
+            return _raw;
+
+        const char* data;
+        std::memcpy(&data, _raw, sizeof(data));
+        return data;
+    }
+    size_t size() const {
+        if(!is_long())
+            return static_cast<unsigned char>(_raw[INLINE_CAPACITY]);
+
+        std::uint64_t length;
+        std::memcpy(&length, _raw + 8, sizeof(length));
+        return length;
+    }
+    std::string str() const {
+        return std::string(data(), size());
+    }
+
+    bool operator==(const string_key& other) const {
+        if(std::memcmp(_raw, other._raw, sizeof(_raw)) == 0)
+            return true;
+        // Short strings are always inline, so only two long keys can
+        // be equal without being bitwise equal.
+        if(!is_long() || !other.is_long() || size() != other.size())
+            return false;
+        return std::memcmp(data(), other.data(), size()) == 0;
+    }
+    bool operator!=(const string_key& other) const {
+        return !(*this == other);
+    }
+
+    size_t hash() const {
+        const char* bytes = is_long() ? data() : _raw;
+        size_t length = is_long() ? size() : sizeof(_raw);
+
+        std::uint64_t h = length;
+        std::uint64_t word;
+        size_t i = 0;
+        for(; i + 8 <= length; i += 8) {
+            std::memcpy(&word, bytes + i, 8);
+            h = mix_hash(h ^ word);
+        }
+        word = 0;
+        std::memcpy(&word, bytes + i, length - i);
+        return mix_hash(h ^ word);
+    }
+
+private:
+    static const char LONG = static_cast<char>(0xff);
+
+    alignas(8) char _raw[INLINE_CAPACITY + 1];
+
+    bool is_long() const {
+        return _raw[INLINE_CAPACITY] == LONG;
+    }
+};
+
+/**
+ * Append-only storage for the characters of long string keys. The
+ * characters never move, so one arena can be shared by several maps;
+ * it must outlive every key it interned.
+ */
+class key_arena {
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    key_arena() : _current(nullptr), _used(0), _bytes(0) {}
+
+    /**
+     * Creates a key that owns its characters: short strings are
+     * stored inline, long strings are copied into the arena.
+     *
+     * @param data - the characters of the key
+     * @param size - the number of characters
+     * @return The key for the characters.
+     */
+    string_key intern(const char* data, size_t size) {
+        if(size <= string_key::INLINE_CAPACITY)
+            return string_key::view(data, size);
+
+        char* copy;
+        if(size > BLOCK_SIZE / 4) {
+            // Large strings get a block of their own.
+            _blocks.emplace_back(new char[size]);
+            copy = _blocks.back().get();
+        } else {
+            if(_current == nullptr || _used + size > BLOCK_SIZE) {
+                _blocks.emplace_back(new char[BLOCK_SIZE]);
+                _current = _blocks.back().get();
+                _used = 0;
+            }
+            copy = _current + _used;
+            _used += size;
+        }
+        std::memcpy(copy, data, size);
+        _bytes += size;
+        return string_key::view(copy, size);
+    }
+    string_key intern(const std::string& str) {
+        return intern(str.data(), str.size());
+    }
+
+    /**
+     * @return Number of characters stored in the arena.
+     */
+    size_t bytes() const {
+        return _bytes;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    char* _current;
+    size_t _used;
+    size_t _bytes;
+};
+
+}
+
+namespace std {
+
+template<>
+struct hash<ljl::string_key> {
+    size_t operator()(const ljl::string_key& key) const {
+        return key.hash();
+    }
+};
+
+}
+
+#endif /* STRINGKEY_H */
+
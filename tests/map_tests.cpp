@@ -8,8 +8,53 @@
 #include "map_tests.h"
 #include <string>
 #include <exception>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <future>
 
 
+namespace {
+    
+int key_hashes = 0;
+
+struct colliding_key {
+    int id;
+    
+    bool operator==(const colliding_key& other) const {
+        return id == other.id;
+    }
+};
+
+struct counted_key {
+    std::string name;
+    
+    bool operator==(const counted_key& other) const {
+        return name == other.name;
+    }
+};
+
+}
+
+namespace std {
+    
+template<>
+struct hash<colliding_key> {
+    size_t operator()(const colliding_key& key) const {
+        return key.id % 4;
+    }
+};
+
+template<>
+struct hash<counted_key> {
+    size_t operator()(const counted_key& key) const {
+        key_hashes++;
+        return hash<string>{}(key.name);
+    }
+};
+
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(map_tests);
 
 map_tests::map_tests() {
@@ -171,15 +216,633 @@ void map_tests::test_reserve() {
     CPPUNIT_ASSERT(_map.capacity() >= 100);
 }
 
-/*
+void map_tests::test_freeze() {
+    for(int i = 0; i < 1000; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    ljl::frozen_map<int, std::string> frozen = _map.freeze();
+    
+    CPPUNIT_ASSERT(frozen.size() == 1000);
+    for(int i = 0; i < 1000; i++) {
+        CPPUNIT_ASSERT(frozen.at(i) == std::to_string(i));
+    }
+}
+
+void map_tests::test_freeze_absent() {
+    for(int i = 0; i < 100; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    ljl::frozen_map<int, std::string> frozen = _map.freeze(true);
+    
+    CPPUNIT_ASSERT(frozen.count(100) == 0);
+    CPPUNIT_ASSERT(frozen.find(-1) == frozen.end());
+    CPPUNIT_ASSERT_THROW(frozen.at(1000), std::out_of_range);
+}
+
+void map_tests::test_shrink_to_fit() {
+    for(int i = 0; i < 1000; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    for(int i = 10; i < 1000; i++) {
+        _map.erase(i);
+    }
+    _map.shrink_to_fit();
+    
+    CPPUNIT_ASSERT(_map.capacity() == 32 && _map.size() == 10);
+    CPPUNIT_ASSERT(_map.at(9) == "9");
+}
+
+void map_tests::test_min_load_factor() {
+    _map.min_load_factor(0.2f);
+    for(int i = 0; i < 1000; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    size_t grown = _map.capacity();
+    for(int i = 0; i < 900; i++) {
+        _map.erase(i);
+    }
+    
+    CPPUNIT_ASSERT(_map.capacity() < grown && _map.size() == 100);
+    CPPUNIT_ASSERT(_map.load_factor() >= 0.2f);
+    CPPUNIT_ASSERT(_map.at(950) == "950");
+    
+    // Lowering the maximum afterwards keeps the minimum below half of it.
+    _map.max_load_factor(0.3f);
+    CPPUNIT_ASSERT(_map.min_load_factor() <= 0.15f);
+}
+
+void map_tests::test_erase_reinsert() {
+    for(int i = 0; i < 10000; i++) {
+        _map.emplace(i, "x");
+        _map.erase(i);
+    }
+    
+    CPPUNIT_ASSERT(_map.empty() && _map.capacity() == 32);
+    CPPUNIT_ASSERT(_map.find(5) == _map.end());
+}
+
+void map_tests::test_allocation_policy() {
+    ljl::allocation_policy policy(ljl::page_size::huge_2mb, 
+            ljl::numa_placement::interleave, 0, true);
+    ljl::array_map<int, std::string> map(policy);
+    map.reserve(200000);
+    for(int i = 0; i < 200000; i++) {
+        map.emplace(i, "x");
+    }
+    
+    CPPUNIT_ASSERT(map.size() == 200000 && map.at(199999) == "x");
+    CPPUNIT_ASSERT(map.get_allocation_policy().pages == ljl::page_size::huge_2mb);
+    
+    // A node that is not online can not be used and is counted as failed.
+    size_t failures = ljl::numa_placement_failures();
+    ljl::array_map<int, int> offline(ljl::allocation_policy(
+            ljl::page_size::normal, ljl::numa_placement::node, 1000));
+    offline[1] = 1;
+    CPPUNIT_ASSERT(ljl::numa_placement_failures() > failures && offline.at(1) == 1);
+}
+
+void map_tests::test_cache_find() {
+    ljl::array_cache<int, std::string> cache(10);
+    cache.insert_or_assign(4, "four");
+    
+    CPPUNIT_ASSERT(cache.find(4) != nullptr && *cache.find(4) == "four");
+    CPPUNIT_ASSERT(cache.find(5) == nullptr);
+    CPPUNIT_ASSERT(cache.hits() == 2 && cache.misses() == 1);
+}
+
+void map_tests::test_cache_evict() {
+    ljl::array_cache<int, std::string> cache(100);
+    for(int i = 0; i < 1000; i++) {
+        cache.insert_or_assign(i, std::to_string(i));
+    }
+    
+    CPPUNIT_ASSERT(cache.size() == 100 && cache.evictions() == 900);
+    int cached = 0;
+    for(int i = 0; i < 1000; i++) {
+        std::string* value = cache.find(i);
+        if(value != nullptr) {
+            CPPUNIT_ASSERT(*value == std::to_string(i));
+            cached++;
+        }
+    }
+    CPPUNIT_ASSERT(cached == 100);
+    
+    size_t handed = 0;
+    cache.evict(10, [&handed](std::pair<int, std::string>&&) { handed++; });
+    CPPUNIT_ASSERT(handed == 10 && cache.size() == 90 && cache.evictions() == 900);
+}
+
+void map_tests::test_cache_second_chance() {
+    ljl::array_cache<int, int> cache(2);
+    cache.insert_or_assign(1, 1);
+    cache.insert_or_assign(2, 2);
+    cache.insert_or_assign(3, 3);
+    cache.find(3);
+    cache.insert_or_assign(4, 4);
+    
+    CPPUNIT_ASSERT(cache.count(3) == 1 && cache.count(4) == 1);
+    CPPUNIT_ASSERT(cache.size() == 2 && cache.evictions() == 2);
+}
+
+void map_tests::test_cache_ttl() {
+    ljl::array_cache<int, int, true> cache(10, std::chrono::milliseconds(1));
+    cache.insert_or_assign(1, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    
+    CPPUNIT_ASSERT(cache.count(1) == 0);
+    CPPUNIT_ASSERT(cache.find(1) == nullptr && cache.empty());
+    
+    // Caches without expiry store no time per slot and take no ttl.
+    typedef ljl::array_cache<int, int> plain_cache;
+    CPPUNIT_ASSERT_THROW(plain_cache(10, std::chrono::milliseconds(1)), 
+            std::invalid_argument);
+}
+
+void map_tests::test_string_keys() {
+    ljl::array_map<std::string, int> map;
+    for(int i = 0; i < 1000; i++) {
+        map.emplace("key " + std::to_string(i), i);
+    }
+    
+    CPPUNIT_ASSERT(map.size() == 1000);
+    CPPUNIT_ASSERT(map.at("key 999") == 999 && map.count("key 1000") == 0);
+    CPPUNIT_ASSERT(map.erase("key 5") == 1 && map.count("key 5") == 0);
+}
+
+void map_tests::test_stored_hash_rehash() {
+    ljl::array_map<counted_key, int> map;
+    for(int i = 0; i < 100; i++) {
+        map[counted_key{std::to_string(i)}] = i;
+    }
+    
+    key_hashes = 0;
+    map.rehash(1024);
+    CPPUNIT_ASSERT(key_hashes == 0);
+    CPPUNIT_ASSERT(map.at(counted_key{"42"}) == 42);
+}
+
+void map_tests::test_string_key_inline() {
+    ljl::key_arena arena;
+    ljl::array_map<ljl::string_key, int> map;
+    map.emplace(arena.intern("short"), 1);
+    std::string lookup = "short";
+    
+    CPPUNIT_ASSERT(arena.bytes() == 0);
+    CPPUNIT_ASSERT(map.at(ljl::string_key::view(lookup)) == 1);
+    CPPUNIT_ASSERT(map.count(ljl::string_key::view("shorter", 7)) == 0);
+}
+
+void map_tests::test_string_key_arena() {
+    ljl::key_arena arena;
+    ljl::array_map<ljl::string_key, int> map;
+    for(int i = 0; i < 1000; i++) {
+        map.emplace(arena.intern("a rather long key number " + std::to_string(i)), i);
+    }
+    std::string lookup = "a rather long key number 567";
+    
+    CPPUNIT_ASSERT(map.size() == 1000 && arena.bytes() > 0);
+    CPPUNIT_ASSERT(map.at(ljl::string_key::view(lookup)) == 567);
+    CPPUNIT_ASSERT((*map.find(ljl::string_key::view(lookup))).first.str() == lookup);
+}
+
+void map_tests::test_merge_into() {
+    ljl::array_map<int, int> source;
+    ljl::array_map<int, int> target;
+    for(int i = 0; i < 100; i++) {
+        source[i] = 1;
+        target[i + 50] = 10;
+    }
+    source.merge_into(target, [](int& a, int b) { a += b; });
+    
+    CPPUNIT_ASSERT(target.size() == 150);
+    CPPUNIT_ASSERT(target.at(0) == 1 && target.at(75) == 11 && target.at(149) == 10);
+}
+
+void map_tests::test_aggregator_partitions() {
+    ljl::aggregator<std::string, int> counts(4);
+    for(size_t t = 0; t < counts.threads(); t++) {
+        for(int i = 0; i < 100; i++) {
+            counts.local(t)[std::to_string(i)] += 1;
+        }
+    }
+    auto sum = [](int& a, int b) { a += b; };
+    
+    ljl::array_map<std::string, int> parts[3];
+    size_t merged = 0;
+    for(int p = 0; p < 3; p++) {
+        counts.merge_partition(parts[p], sum, p, 3);
+        merged += parts[p].size();
+    }
+    ljl::array_map<std::string, int> total = counts.merge(sum);
+    
+    CPPUNIT_ASSERT(merged == 100 && total.size() == 100);
+    CPPUNIT_ASSERT(total.at("42") == 4);
+}
+
+void map_tests::test_adversarial_keys() {
+    // Multiples of a power of two share one slot under plain hash % capacity.
+    ljl::array_map<int, int> map;
+    for(int i = 0; i < 50000; i++) {
+        map.emplace(i << 16, i);
+    }
+    
+    CPPUNIT_ASSERT(map.size() == 50000 && map.at(4242 << 16) == 4242);
+    CPPUNIT_ASSERT(map.max_probe_length() < 300);
+}
+
+void map_tests::test_colliding_hashes() {
+    ljl::array_map<colliding_key, int> map;
+    for(int i = 0; i < 2000; i++) {
+        map.emplace(colliding_key{i}, i);
+    }
+    
+    CPPUNIT_ASSERT(map.size() == 2000);
+    CPPUNIT_ASSERT(map.at(colliding_key{1999}) == 1999);
+    CPPUNIT_ASSERT(map.count(colliding_key{2000}) == 0);
+}
+
+void map_tests::test_snapshot() {
+    for(int i = 0; i < 10000; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    const ljl::array_map_snapshot<int, std::string> snapshot = _map.snapshot();
+    int found = 0;
+    std::thread reader([&snapshot, &found]() {
+        for(int i = 0; i < 10000; i++)
+            found += snapshot.at(i) == std::to_string(i);
+    });
+    _map[5] = "changed";
+    _map.erase(6);
+    for(int i = 10000; i < 20000; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    reader.join();
+    
+    CPPUNIT_ASSERT(found == 10000 && snapshot.count(10000) == 0);
+    CPPUNIT_ASSERT(_map.at(5) == "changed" && _map.count(6) == 0);
+    CPPUNIT_ASSERT(snapshot.at(5) == "5" && snapshot.find(6)->second == "6");
+    CPPUNIT_ASSERT(snapshot.size() == 10000 && _map.size() == 19999);
+}
+
+void map_tests::test_snapshot_rehash() {
+    _map.emplace(1, "one");
+    ljl::array_map_snapshot<int, std::string> snapshot = _map.snapshot();
+    ljl::array_map<int, std::string> copy;
+    copy = _map;
+    for(int i = 2; i < 1000; i++) {
+        _map.emplace(i, std::to_string(i));
+    }
+    copy[2] = "two";
+    
+    CPPUNIT_ASSERT(snapshot.size() == 1 && snapshot.at(1) == "one");
+    CPPUNIT_ASSERT(std::distance(snapshot.begin(), snapshot.end()) == 1);
+    CPPUNIT_ASSERT(copy.size() == 2 && copy.at(1) == "one" && copy.at(2) == "two");
+    CPPUNIT_ASSERT(_map.size() == 999 && _map.at(1) == "one" && _map.at(2) == "2");
+}
+
+void map_tests::test_spill() {
+    ljl::spill_map<int, int> map(64, "/tmp");
+    for(int i = 0; i < 5000; i++) {
+        map.insert_or_assign(i, i);
+    }
+    for(int i = 0; i < 5000; i += 7) {
+        map.erase(i);
+    }
+    map.insert_or_assign(42, -42);
+    
+    CPPUNIT_ASSERT(map.hot_size() <= 64 && map.segments() <= 12);
+    // Size tiered merges rewrite each element once per level.
+    CPPUNIT_ASSERT(map.records_written() <= 5000 * 6);
+    CPPUNIT_ASSERT(map.count(7) == 0 && map.count(8) == 1 && map.count(5000) == 0);
+    CPPUNIT_ASSERT(*map.find(42) == -42 && *map.find(4999) == 4999);
+    
+    size_t reads = map.page_reads();
+    int found = 0;
+    for(int i = 1; i < 5000; i += 7) {
+        const int* value = map.find(i);
+        found += value != nullptr && *value == i;
+    }
+    CPPUNIT_ASSERT(found == 715);
+    CPPUNIT_ASSERT(map.page_reads() - reads <= 715 + 715 / 10);
+}
+
+void map_tests::test_spill_find_many() {
+    ljl::spill_map<int, int> map(100, "/tmp");
+    std::vector<int> keys;
+    for(int i = 0; i < 3000; i++) {
+        map.insert_or_assign(i, 2 * i);
+        keys.push_back(i * 2);
+    }
+    
+    long sum = 0;
+    size_t reads = map.page_reads();
+    size_t found = map.find_many(keys, [&](int key, int value) {
+        CPPUNIT_ASSERT(value == 2 * key);
+        sum += value;
+    });
+    
+    CPPUNIT_ASSERT(found == 1500 && sum == 2 * 1499 * 1500);
+    // Half of 3000 records of 24 bytes live in at most 18 pages per segment.
+    CPPUNIT_ASSERT(map.page_reads() - reads <= map.segments() * 18 + 8);
+}
+
+void map_tests::test_spill_find_async() {
+    ljl::spill_map<int, int> map(100, "/tmp");
+    std::vector<int> keys;
+    for(int i = 0; i < 3000; i++) {
+        map.insert_or_assign(i, 2 * i);
+        keys.push_back(i * 2);
+    }
+    for(int i = 0; i < 3000; i += 10) {
+        map.erase(i);
+    }
+    map.insert_or_assign(4, -4);
+    
+    std::future<std::vector<std::pair<int, int>>> pending = 
+            map.find_many_async(keys, 4);
+    std::vector<std::pair<int, int>> found = pending.get();
+    long sum = 0;
+    map.find_many(keys, [&](int key, int value) { sum += key + value; });
+    
+    CPPUNIT_ASSERT(found.size() == 1200);
+    for(const std::pair<int, int>& element : found) {
+        CPPUNIT_ASSERT(element.first % 10 != 0 && element.first < 3000);
+        CPPUNIT_ASSERT(element.second == (element.first == 4 ? -4 : 2 * element.first));
+        sum -= element.first + element.second;
+    }
+    CPPUNIT_ASSERT(sum == 0);
+}
+
+void map_tests::test_spill_colliding() {
+    ljl::spill_map<colliding_key, int> map(32, "/tmp", 16);
+    for(int i = 0; i < 2000; i++) {
+        map.insert_or_assign(colliding_key{i}, i);
+    }
+    map.erase(colliding_key{1001});
+    
+    int found = 0;
+    for(int i = 0; i < 2000; i++) {
+        const int* value = map.find(colliding_key{i});
+        found += value != nullptr && *value == i;
+    }
+    CPPUNIT_ASSERT(found == 1999 && map.count(colliding_key{1001}) == 0);
+}
+
+void map_tests::test_slab_map() {
+    struct wide {
+        long id;
+        char payload[192];
+    };
+    ljl::slab_map<int, wide> map;
+    for(int i = 0; i < 1000; i++) {
+        map[i].id = i;
+    }
+    for(int i = 0; i < 1000; i += 2) {
+        map.erase(i);
+    }
+    for(int i = 1000; i < 1500; i++) {
+        map.emplace(i, wide{i, {}});
+    }
+    
+    // Erased slab entries are reused before the slab grows.
+    CPPUNIT_ASSERT(map.size() == 1000 && map.slab_size() == 1000);
+    CPPUNIT_ASSERT(map.count(2) == 0 && map.at(1499).id == 1499);
+    CPPUNIT_ASSERT(map.find(7)->second.id == 7 && map.find(8) == map.end());
+    
+    long sum = 0;
+    const ljl::slab_map<int, wide>& view = map;
+    for(auto element : view) {
+        CPPUNIT_ASSERT(element.first == element.second.id);
+        sum += element.second.id;
+    }
+    CPPUNIT_ASSERT(sum == 250000 + 624750);
+    
+    // Inserting, updating and erasing hash the key once each.
+    ljl::slab_map<counted_key, int> counted;
+    key_hashes = 0;
+    counted[counted_key{"a"}] = 1;
+    counted.emplace(counted_key{"b"}, 2);
+    counted[counted_key{"a"}] += 1;
+    counted.erase(counted_key{"b"});
+    CPPUNIT_ASSERT(key_hashes == 4 && counted.size() == 1);
+}
+
+void map_tests::test_slab_map_shrink() {
+    ljl::slab_map<std::string, std::string> map;
+    for(int i = 0; i < 1000; i++) {
+        map[std::to_string(i)] = "value " + std::to_string(i);
+    }
+    for(int i = 0; i < 900; i++) {
+        map.erase(std::to_string(i));
+    }
+    map.shrink_to_fit();
+    
+    CPPUNIT_ASSERT(map.size() == 100 && map.slab_size() == 100);
+    CPPUNIT_ASSERT(map.capacity() < 1000);
+    CPPUNIT_ASSERT(map.at("950") == "value 950");
+}
+
+void map_tests::test_precomputed_hash() {
+    ljl::array_map<counted_key, int> map;
+    auto hash = map.hash_function();
+    std::vector<counted_key> keys;
+    std::vector<size_t> hashes;
+    for(int i = 0; i < 200; i++) {
+        keys.push_back(counted_key{std::to_string(i)});
+        hashes.push_back(hash(keys.back()));
+    }
+    
+    key_hashes = 0;
+    for(int i = 0; i < 200; i++) {
+        map.emplace_hashed(keys[i], i, hashes[i]);
+    }
+    map.subscript_hashed(keys[5], hashes[5]) += 100;
+    map.erase(keys[7], hashes[7]);
+    
+    CPPUNIT_ASSERT(map.at(keys[5], hashes[5]) == 105);
+    CPPUNIT_ASSERT(map.count(keys[7], hashes[7]) == 0);
+    CPPUNIT_ASSERT(map.find(keys[9], hashes[9])->second == 9);
+    CPPUNIT_ASSERT(key_hashes == 0);
+}
+
+void map_tests::test_precomputed_hash_maps() {
+    ljl::array_map<std::string, int> first;
+    ljl::array_map<std::string, int> second;
+    for(int i = 0; i < 100; i++) {
+        first[std::to_string(i)] = i;
+        second[std::to_string(i * 2)] = i;
+    }
+    
+    int both = 0;
+    for(int i = 0; i < 100; i++) {
+        std::string key = std::to_string(i);
+        size_t h = first.hash_function()(key);
+        both += first.count(key, h) && second.count(key, h);
+    }
+    CPPUNIT_ASSERT(both == 50);
+}
+
+template<typename Probe>
+static bool probe_roundtrip() {
+    ljl::array_map<int, int, Probe> map;
+    for(int i = 0; i < 20000; i++) {
+        map.emplace(i * 3, i);
+    }
+    for(int i = 0; i < 20000; i += 2) {
+        map.erase(i * 3);
+    }
+    for(int i = 0; i < 20000; i++) {
+        if(map.count(i * 3) != (size_t)(i % 2))
+            return false;
+    }
+    map[1] = 1;
+    return map.size() == 10001 && map.at(3 * 9999) == 9999 && map.at(1) == 1;
+}
+
+void map_tests::test_probe_policies() {
+    CPPUNIT_ASSERT(probe_roundtrip<ljl::linear_probe>());
+    CPPUNIT_ASSERT(probe_roundtrip<ljl::quadratic_probe>());
+    CPPUNIT_ASSERT(probe_roundtrip<ljl::double_hash_probe>());
+}
+
+void map_tests::test_probe_policy_capacity() {
+    ljl::array_map<std::string, int, ljl::quadratic_probe> map;
+    map.reserve(1000);
+    size_t capacity = map.capacity();
+    for(int i = 0; i < 1000; i++) {
+        map[std::to_string(i)] = i;
+    }
+    
+    // Triangular probing needs a power of two to reach every slot.
+    CPPUNIT_ASSERT((capacity & (capacity - 1)) == 0 && capacity >= 1000);
+    CPPUNIT_ASSERT(map.capacity() == capacity && map.at("999") == 999);
+}
+
+void map_tests::test_ordered_map() {
+    ljl::ordered_map<std::string, int> map;
+    for(int i = 0; i < 1000; i++) {
+        map.emplace(std::to_string(999 - i), i);
+    }
+    for(int i = 0; i < 1000; i += 3) {
+        map.erase(std::to_string(i));
+    }
+    map["new"] = -1;
+    map.emplace("5", 1000);
+    
+    CPPUNIT_ASSERT(map.size() == 667 && map.count("3") == 0);
+    CPPUNIT_ASSERT(map.at("998") == 1 && map.find("5")->second == 994);
+    
+    // Elements iterate in insertion order, erased ones left out.
+    int previous = -1;
+    bool ordered = true;
+    for(const auto& element : map) {
+        if(element.first == "new")
+            break;
+        ordered = ordered && element.second > previous;
+        previous = element.second;
+    }
+    CPPUNIT_ASSERT(ordered && previous == 998);
+}
+
+void map_tests::test_ordered_map_index() {
+    ljl::ordered_map<int, long> small;
+    for(int i = 0; i < 50; i++) {
+        small[i] = i;
+    }
+    ljl::ordered_map<int, long, ljl::quadratic_probe> large;
+    large.reserve(1000);
+    for(int i = 0; i < 1000; i++) {
+        large[i * 7] = i;
+    }
+    
+    // Slots are one byte below 255 slots, two bytes below 65535.
+    CPPUNIT_ASSERT(small.index_bytes() == small.capacity() && small.capacity() < 255);
+    CPPUNIT_ASSERT(large.index_bytes() == 2 * large.capacity());
+    CPPUNIT_ASSERT(large.capacity() == 2048 && large.at(6993) == 999);
+    CPPUNIT_ASSERT(large.begin()->first == 0 && large.count(8) == 0);
+}
+
+void map_tests::test_freeze_parallel() {
+    ljl::array_map<std::string, int> map;
+    for(int i = 0; i < 200000; i++) {
+        map.emplace(std::to_string(i), i);
+    }
+    ljl::frozen_map<std::string, int> parallel = map.freeze(true, 4);
+    ljl::frozen_map<std::string, int> serial = map.freeze(true, 1);
+    
+    CPPUNIT_ASSERT(parallel.size() == 200000 && parallel.count("200000") == 0);
+    // Threads only change the build order, not the resulting layout.
+    CPPUNIT_ASSERT(std::equal(parallel.begin(), parallel.end(), serial.begin()));
+    for(int i = 0; i < 200000; i += 997) {
+        CPPUNIT_ASSERT(parallel.at(std::to_string(i)) == i);
+    }
+}
+
+void map_tests::test_freeze_colliding() {
+    ljl::array_map<colliding_key, int> map;
+    for(int i = 0; i < 100; i++) {
+        map.emplace(colliding_key{i}, i);
+    }
+    ljl::frozen_map<colliding_key, int> frozen = map.freeze(true);
+    
+    CPPUNIT_ASSERT(frozen.size() == 100);
+    for(int i = 0; i < 100; i++) {
+        CPPUNIT_ASSERT(frozen.at(colliding_key{i}) == i);
+    }
+    CPPUNIT_ASSERT(frozen.count(colliding_key{100}) == 0);
+    CPPUNIT_ASSERT(frozen.find(colliding_key{-4}) == frozen.end());
+}
+
+void map_tests::test_aggregator_threads() {
+    ljl::aggregator<std::string, int> counts(4);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < counts.threads(); t++) {
+        threads.emplace_back([&counts, t]() {
+            for(int i = 0; i < 20000; i++) {
+                counts.local(t)[std::to_string(i % 5000)] += 1;
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    auto sum = [](int& a, int b) { a += b; };
+    
+    std::vector<ljl::array_map<std::string, int>> parts = counts.merge_parallel(sum, 3);
+    
+    // The same partitions merged with merge_partition from concurrent threads.
+    ljl::array_map<std::string, int> concurrent[3];
+    threads.clear();
+    for(int p = 0; p < 3; p++) {
+        threads.emplace_back([&, p]() {
+            counts.merge_partition(concurrent[p], sum, p, 3);
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    size_t total = 0;
+    for(int p = 0; p < 3; p++) {
+        total += parts[p].size();
+        CPPUNIT_ASSERT(parts[p].size() == concurrent[p].size());
+        for(const auto& element : parts[p]) {
+            CPPUNIT_ASSERT(element.second == 16);
+            CPPUNIT_ASSERT(concurrent[p].at(element.first) == 16);
+        }
+    }
+    CPPUNIT_ASSERT(total == 5000);
+}
+
 void map_tests::test_iterators() {
     ljl::array_map<int, int> int_map;
-    for(int i = 0; i < 10; i++) {
+    for(int i = 0; i < 100; i++) {
         int_map.emplace(i, i*10);
     }
+    const ljl::array_map<int, int>& const_map = int_map;
     
     int sum = 0;
-    std::for_each(_map.begin(), _map.end(), [](std::pair<int int> &n){ sum += n; });
-    CPPUNIT_ASSERT_EQUAL(sum, 550);
+    std::for_each(const_map.begin(), const_map.end(), 
+            [&sum](const std::pair<int, int> &n){ sum += n.second; });
+    CPPUNIT_ASSERT_EQUAL(sum, 49500);
 }
-*/
@@ -18,6 +18,12 @@
 
 #include <string>
 #include "../arraymap.h"
+#include "../arraycache.h"
+#include "../stringkey.h"
+#include "../aggregator.h"
+#include "../spillmap.h"
+#include "../slabmap.h"
+#include "../orderedmap.h"
 
 class map_tests : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST_SUITE(map_tests);
@@ -43,7 +49,42 @@ class map_tests : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST(test_rehash);
     CPPUNIT_TEST(test_rehash_by_assign);
     CPPUNIT_TEST(test_reserve);
-    //CPPUNIT_TEST(test_iterators);
+    CPPUNIT_TEST(test_freeze);
+    CPPUNIT_TEST(test_freeze_absent);
+    CPPUNIT_TEST(test_shrink_to_fit);
+    CPPUNIT_TEST(test_min_load_factor);
+    CPPUNIT_TEST(test_erase_reinsert);
+    CPPUNIT_TEST(test_allocation_policy);
+    CPPUNIT_TEST(test_cache_find);
+    CPPUNIT_TEST(test_cache_evict);
+    CPPUNIT_TEST(test_cache_second_chance);
+    CPPUNIT_TEST(test_cache_ttl);
+    CPPUNIT_TEST(test_string_keys);
+    CPPUNIT_TEST(test_stored_hash_rehash);
+    CPPUNIT_TEST(test_string_key_inline);
+    CPPUNIT_TEST(test_string_key_arena);
+    CPPUNIT_TEST(test_merge_into);
+    CPPUNIT_TEST(test_aggregator_partitions);
+    CPPUNIT_TEST(test_adversarial_keys);
+    CPPUNIT_TEST(test_colliding_hashes);
+    CPPUNIT_TEST(test_snapshot);
+    CPPUNIT_TEST(test_snapshot_rehash);
+    CPPUNIT_TEST(test_spill);
+    CPPUNIT_TEST(test_spill_find_many);
+    CPPUNIT_TEST(test_spill_find_async);
+    CPPUNIT_TEST(test_spill_colliding);
+    CPPUNIT_TEST(test_slab_map);
+    CPPUNIT_TEST(test_slab_map_shrink);
+    CPPUNIT_TEST(test_precomputed_hash);
+    CPPUNIT_TEST(test_precomputed_hash_maps);
+    CPPUNIT_TEST(test_probe_policies);
+    CPPUNIT_TEST(test_probe_policy_capacity);
+    CPPUNIT_TEST(test_ordered_map);
+    CPPUNIT_TEST(test_ordered_map_index);
+    CPPUNIT_TEST(test_freeze_parallel);
+    CPPUNIT_TEST(test_freeze_colliding);
+    CPPUNIT_TEST(test_aggregator_threads);
+    CPPUNIT_TEST(test_iterators);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -77,7 +118,42 @@ private:
     void test_rehash();
     void test_rehash_by_assign();
     void test_reserve();
-    //void test_iterators();
+    void test_freeze();
+    void test_freeze_absent();
+    void test_shrink_to_fit();
+    void test_min_load_factor();
+    void test_erase_reinsert();
+    void test_allocation_policy();
+    void test_cache_find();
+    void test_cache_evict();
+    void test_cache_second_chance();
+    void test_cache_ttl();
+    void test_string_keys();
+    void test_stored_hash_rehash();
+    void test_string_key_inline();
+    void test_string_key_arena();
+    void test_merge_into();
+    void test_aggregator_partitions();
+    void test_adversarial_keys();
+    void test_colliding_hashes();
+    void test_snapshot();
+    void test_snapshot_rehash();
+    void test_spill();
+    void test_spill_find_many();
+    void test_spill_find_async();
+    void test_spill_colliding();
+    void test_slab_map();
+    void test_slab_map_shrink();
+    void test_precomputed_hash();
+    void test_precomputed_hash_maps();
+    void test_probe_policies();
+    void test_probe_policy_capacity();
+    void test_ordered_map();
+    void test_ordered_map_index();
+    void test_freeze_parallel();
+    void test_freeze_colliding();
+    void test_aggregator_threads();
+    void test_iterators();
 };
 
 #endif /* MAP_TESTS_H */